@@ -0,0 +1,186 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QTextStream>
+
+#include "analysis.h"
+#include "persistence.h"
+#include "text/MarkdownParser.h"
+#include "text/TextFormatter.h"
+#include "text/UserData.h"
+#include "text/outline.h"
+#include "text/wordcount.h"
+
+namespace {
+    bool readDocument(QTextDocument& document, const QString& fileName)
+    {
+        QFile file(fileName);
+
+        if (!file.open(QFile::ReadOnly)) {
+            return false;
+        }
+
+        QByteArray data = file.readAll();
+
+        if (data.startsWith("\xEF\xBB\xBF")) {
+            // Skip the UTF-8 byte order mark.
+            data.remove(0, 3);
+        }
+
+        if (QFileInfo(fileName).suffix() == persistence::format_markdown) {
+            MarkdownParser(&document).parse(data.constData(), data.size());
+        } else {
+            document.setPlainText(QString::fromUtf8(data));
+        }
+
+        return true;
+    }
+
+    //! Counts the words of each block like FormattableTextArea::countWords().
+    void countWords(QTextDocument& document)
+    {
+        for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+            UserData::fromBlock(block).setWordCount(wordcount::count(block));
+        }
+    }
+
+    QVector<analysis::Segment> createOutline(QTextDocument& document)
+    {
+        const QVector<outline::Entry> entries = outline::entries(&document);
+        QVector<analysis::Segment> segments;
+
+        for (int i = 0; i < entries.size(); i++) {
+            const outline::Entry& entry = entries.at(i);
+            const int end = i + 1 < entries.size() ? entries.at(i + 1).position : document.characterCount();
+            const QTextBlock first = document.findBlock(entry.position);
+            int words = 0;
+
+            for (QTextBlock block = first; block.isValid() && block.position() < end; block = block.next()) {
+                words += UserData::fromBlock(block).wordCount();
+            }
+
+            segments.append({
+                entry.position,
+                entry.depth,
+                outline::heading(first),
+                outline::subheading(first),
+                words
+            });
+        }
+
+        return segments;
+    }
+
+    bool exportDocument(QTextDocument& document, const QString& fileName, const QString& format)
+    {
+        QSaveFile file(fileName);
+
+        if (!file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
+            return false;
+        }
+
+        QTextStream stream(&file);
+        stream.setCodec("UTF-8");
+
+        if (format == persistence::format_markdown) {
+            MarkdownParser(&document).write(stream);
+        } else if (format == QLatin1String("html")) {
+            stream << document.toHtml();
+        } else {
+            stream << document.toPlainText();
+        }
+
+        stream.flush();
+
+        return file.commit();
+    }
+}
+
+analysis::Result analysis::analyze(const QString& fileName, const Options& options)
+{
+    Result result;
+    result.fileName = fileName;
+
+    QTextDocument document;
+    document.setUndoRedoEnabled(false);
+
+    if (!readDocument(document, fileName)) {
+        result.error = QStringLiteral("Cannot open file");
+
+        return result;
+    }
+
+    {
+        // The formatter determines the comment ranges that are excluded
+        // from the word count.
+        TextFormatter formatter(&document);
+        formatter.refresh();
+        countWords(document);
+    }
+
+    for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+        result.wordCount += UserData::fromBlock(block).wordCount();
+    }
+
+    result.characterCount = document.characterCount();
+    result.paragraphCount = document.blockCount();
+    result.pageCount = wordcount::pageCount(result.wordCount);
+
+    if (options.outline) {
+        result.outline = createOutline(document);
+    }
+
+    if (!options.exportFormat.isEmpty()) {
+        const QString exportFileName = QDir(options.outputDirectory).filePath(QFileInfo(fileName).completeBaseName() + "." + options.exportFormat);
+
+        if (exportDocument(document, exportFileName, options.exportFormat)) {
+            result.exportFileName = exportFileName;
+        } else {
+            result.error = QStringLiteral("Cannot export to ") + exportFileName;
+        }
+    }
+
+    return result;
+}
+
+QJsonObject analysis::toJson(const Result& result)
+{
+    QJsonObject object {
+        { "file", result.fileName }
+    };
+
+    if (!result.error.isEmpty()) {
+        object.insert("error", result.error);
+    }
+
+    object.insert("characters", result.characterCount);
+    object.insert("paragraphs", result.paragraphCount);
+    object.insert("words", result.wordCount);
+    object.insert("pages", result.pageCount);
+
+    if (!result.outline.isEmpty()) {
+        QJsonArray outline;
+
+        for (const Segment& segment : result.outline) {
+            outline.append(QJsonObject {
+                { "position", segment.position },
+                { "depth", segment.depth },
+                { "heading", segment.heading },
+                { "subheading", segment.subheading },
+                { "words", segment.wordCount }
+            });
+        }
+
+        object.insert("outline", outline);
+    }
+
+    if (!result.exportFileName.isEmpty()) {
+        object.insert("export", result.exportFileName);
+    }
+
+    return object;
+}
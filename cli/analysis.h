@@ -0,0 +1,47 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+//! Processes a single manuscript without a text area or QML engine. All
+//! functions in this namespace are safe to call from worker threads, as
+//! long as ThemeManager::instance() was first called on the main thread.
+namespace analysis {
+    struct Options {
+        //! If true, the outline of the document is included in the result.
+        bool outline = false;
+        //! One of "md", "html" or "txt". If empty, nothing is exported.
+        QString exportFormat;
+        //! The directory exported files are written to.
+        QString outputDirectory;
+    };
+
+    //! A DocumentSegment of the manuscript.
+    struct Segment {
+        int position;
+        int depth;
+        QString heading;
+        QString subheading;
+        int wordCount;
+    };
+
+    struct Result {
+        QString fileName;
+        //! Empty if the file was processed successfully.
+        QString error;
+        int characterCount = 0;
+        int paragraphCount = 0;
+        int wordCount = 0;
+        int pageCount = 0;
+        QVector<Segment> outline;
+        QString exportFileName;
+    };
+
+    //! Loads the file and counts its words the same way the editor does.
+    Result analyze(const QString& fileName, const Options& options);
+    QJsonObject toJson(const Result& result);
+}
+
+#endif // ANALYSIS_H
@@ -0,0 +1,104 @@
+#include <QCommandLineParser>
+#include <QDir>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include "analysis.h"
+#include "ErrorManager.h"
+#include "theming/ThemeManager.h"
+
+int main(int argc, char *argv[])
+{
+    // The command-line tool never shows a window, so don't require a
+    // display. A QGuiApplication is still needed for fonts.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QGuiApplication::setOrganizationName("cengels");
+    QGuiApplication::setOrganizationDomain("www.cengels.com");
+    QGuiApplication::setApplicationName("Skywriter");
+    QGuiApplication::setApplicationVersion(QString::number(VERSION_MAJOR) + "."
+                                      + QString::number(VERSION_MINOR) + "."
+                                      + QString::number(VERSION_BUILD));
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Counts words in, outlines and exports Skywriter manuscripts. Results are printed as JSON.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        { "outline", "Includes the outline (headings and their word counts) of each file." },
+        { "export", "Exports each file to the format md, html or txt.", "format" },
+        { { "o", "output-dir" }, "The directory exported files are written to. Defaults to the current directory.", "directory", "." },
+        { { "j", "jobs" }, "The number of files processed in parallel. Defaults to the number of cores.", "count" }
+    });
+    parser.addPositionalArgument("files", "The manuscripts to process.", "files...");
+    parser.process(app);
+
+    QTextStream err(stderr);
+    const QStringList files = parser.positionalArguments();
+
+    if (files.isEmpty()) {
+        parser.showHelp(2);
+    }
+
+    analysis::Options options;
+    options.outline = parser.isSet("outline");
+    options.exportFormat = parser.value("export");
+    options.outputDirectory = parser.value("output-dir");
+
+    if (!options.exportFormat.isEmpty() && !QStringList { "md", "html", "txt" }.contains(options.exportFormat)) {
+        err << "Unsupported export format: " << options.exportFormat << Qt::endl;
+        return 2;
+    }
+
+    if (!options.exportFormat.isEmpty() && !QDir().mkpath(options.outputDirectory)) {
+        err << "Cannot create output directory: " << options.outputDirectory << Qt::endl;
+        return 2;
+    }
+
+    if (parser.isSet("jobs")) {
+        bool ok;
+        const int jobs = parser.value("jobs").toInt(&ok);
+
+        if (!ok || jobs <= 0) {
+            err << "Invalid number of jobs: " << parser.value("jobs") << Qt::endl;
+            return 2;
+        }
+
+        QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    }
+
+    // The singletons are created lazily. They must be created here, on the
+    // main thread, before the workers access them concurrently.
+    ThemeManager::instance()->setParent(&app);
+    ErrorManager::instance()->setParent(&app);
+
+    const QVector<analysis::Result> results = QtConcurrent::blockingMapped<QVector<analysis::Result>>(files, [options](const QString& file) {
+        return analysis::analyze(file, options);
+    });
+
+    QJsonArray array;
+    int totalWords = 0;
+    bool failed = false;
+
+    for (const analysis::Result& result : results) {
+        array.append(analysis::toJson(result));
+        totalWords += result.wordCount;
+        failed = failed || !result.error.isEmpty();
+    }
+
+    const QJsonObject root {
+        { "files", array },
+        { "words", totalWords }
+    };
+
+    QTextStream(stdout) << QJsonDocument(root).toJson();
+
+    return failed ? 1 : 0;
+}
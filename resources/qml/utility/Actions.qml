@@ -32,15 +32,50 @@ QtObject {
     }
 
     function loadDocument(url) {
-        textArea.load(url);
+        const rules = Settings.Document.wordCountRules[toLocalFileString(url)];
+        textArea.load(url, rules !== undefined ? rules : FormattableTextArea.WordCountRules.Standard);
         ProgressTracker.changeActiveFile(url);
     }
 
     function reset() {
         textArea.reset();
+        textArea.wordCountRules = FormattableTextArea.WordCountRules.Standard;
         ProgressTracker.changeActiveFile(textArea.fileUrl);
     }
 
+    readonly property var wordCountRuleOptions: [
+        { name: qsTr("Standard"), value: FormattableTextArea.WordCountRules.Standard },
+        { name: qsTr("Count Each Ideograph"), value: FormattableTextArea.WordCountRules.Ideographic },
+        { name: qsTr("Split Hyphenated Words"), value: FormattableTextArea.WordCountRules.SplitCompounds },
+        { name: qsTr("Split at Apostrophes"), value: FormattableTextArea.WordCountRules.SplitApostrophes }
+    ]
+
+    function setWordCountRules(rules) {
+        textArea.wordCountRules = rules;
+        rememberWordCountRules();
+    }
+
+    //! Stores the word counting rules of the document under its file path,
+    //! so that they are applied again the next time the file is loaded.
+    function rememberWordCountRules() {
+        const path = toLocalFileString(textArea.fileUrl);
+
+        if (!path) {
+            return;
+        }
+
+        // The settings are only written if the whole object is replaced.
+        const rules = Object.assign({}, Settings.Document.wordCountRules);
+
+        if (textArea.wordCountRules === FormattableTextArea.WordCountRules.Standard) {
+            delete rules[path];
+        } else {
+            rules[path] = textArea.wordCountRules;
+        }
+
+        Settings.Document.wordCountRules = rules;
+    }
+
     readonly property FileDialog openDialog: FileDialog {
         title: qsTr("Open...")
         modality: Qt.ApplicationModal
@@ -180,6 +215,9 @@ QtObject {
 
         function onAccepted() {
             saveWithPrompt();
+            // Saves are committed in the background. The window may only
+            // close once the document is no longer marked as modified.
+            textArea.waitForWrites();
             mainWindow.close();
         }
 
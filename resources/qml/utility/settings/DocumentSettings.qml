@@ -6,6 +6,10 @@ Sky.Settings {
     category: "document"
     property string lastFile
     property int caretPosition
+    //! The FormattableTextArea.WordCountRules chosen for each document,
+    //! keyed by its local file path. Documents without an entry are counted
+    //! with the standard rules.
+    property var wordCountRules: ({})
     property var autoReplacements: [
         ["\"", "“", "”"],
         ["'", "‘", "’"]
@@ -1,3 +1,4 @@
+import QtQml 2.14
 import QtQuick 2.14
 import QtQuick.Controls 2.14
 import QtQuick.Window 2.14
@@ -231,6 +232,27 @@ ApplicationWindow {
                 }
                 Sky.MenuItem { action: actions.finishProgressItem }
                 MenuSeparator {}
+                Sky.Menu {
+                    id: wordCountingMenu
+                    title: qsTr("Word Counting")
+
+                    Instantiator {
+                        model: actions.wordCountRuleOptions
+                        delegate: Sky.MenuItem {
+                            text: modelData.name
+                            checkable: true
+                            checked: textArea.wordCountRules === modelData.value
+                            onTriggered: {
+                                actions.setWordCountRules(modelData.value);
+                                // Triggering toggles the item, which replaces the binding.
+                                checked = Qt.binding(() => textArea.wordCountRules === modelData.value);
+                            }
+                        }
+                        onObjectAdded: wordCountingMenu.insertItem(index, object)
+                        onObjectRemoved: wordCountingMenu.removeItem(object)
+                    }
+                }
+                MenuSeparator {}
                 Sky.MenuItem {
                     text: qsTr("Preferences...")
                     onTriggered: {
@@ -564,11 +586,21 @@ ApplicationWindow {
                         previousContentHeight = contentHeight;
                     }
 
+                    // Documents are loaded in the background, so the caret
+                    // can only be restored once the document has been swapped in.
+                    property int pendingCaretPosition: -1
+                    onLoaded: {
+                        if (pendingCaretPosition >= 0) {
+                            textArea.caretPosition = pendingCaretPosition;
+                            pendingCaretPosition = -1;
+                            verticalScrollbar.centerOnCaret();
+                        }
+                    }
+
                     Component.onCompleted: {
                         if (Settings.Document.lastFile != null) {
+                            pendingCaretPosition = Settings.Document.caretPosition;
                             actions.loadDocument(fromLocalFileString(Settings.Document.lastFile));
-                            textArea.caretPosition = Settings.Document.caretPosition;
-                            verticalScrollbar.centerOnCaret();
                         }
 
                         Settings.Document.caretPosition = Qt.binding(() => textArea.caretPosition);
@@ -590,14 +622,17 @@ ApplicationWindow {
 
                     onFileUrlChanged: {
                         Settings.Document.lastFile = toLocalFileString(textArea.fileUrl)
+                        // Keeps the rules of a document that was saved under a new name.
+                        actions.rememberWordCountRules();
                     }
 
                     property int oldWordCount;
                     property bool progressSuspended: false
                     onWordCountChanged: {
                         // If neither canUndo nor canRedo are true, the word count change
-                        // was not prompted by the user (e.g. during loading).
-                        if (!progressSuspended && (canUndo || canRedo) && oldWordCount !== wordCount) {
+                        // was not prompted by the user (e.g. during loading). The same is
+                        // true for the count that arrives when counting a document finishes.
+                        if (!progressSuspended && !countingWords && (canUndo || canRedo) && oldWordCount !== wordCount) {
                             ProgressTracker.addProgress(wordCount - oldWordCount);
                         }
 
@@ -635,7 +670,9 @@ ApplicationWindow {
                     onContextMenuRequested: contextMenu.popup()
 
                     onSearchResultCountChanged: {
-                        if (Settings.User.groups.editor.instantSearch) {
+                        // Background searches report their matches in batches,
+                        // but only the final count should move the caret.
+                        if (Settings.User.groups.editor.instantSearch && !textArea.searching) {
                             if (textArea.searchResultCount > 0) {
                                 textArea.jumpToNext();
                             } else {
@@ -924,7 +961,7 @@ ApplicationWindow {
                         && Mouse.windowPosition.x < edgeTolerance
                         && !fileMenu.visible
                         && Mouse.buttons === Qt.NoButton) {
-                    const index = textArea.documentStructure.indexOf(textArea.currentDocumentSegment);
+                    const index = textArea.documentStructureModel.indexOf(textArea.currentDocumentSegment);
                     listView.positionViewAtIndex(index, ListView.Visible);
                     documentStructureDrawer.open();
                 } else if (documentStructureDrawer.opened
@@ -944,13 +981,13 @@ ApplicationWindow {
             anchors.bottomMargin: 12
             boundsBehavior: Flickable.StopAtBounds
             flickDeceleration: 800
-            model: textArea.documentStructure
+            model: textArea.documentStructureModel
             spacing: 12
             ScrollBar.vertical: ScrollBar { id: drawerScrollBar; width: 12 }
             delegate: Control {
                 width: listView.width - leftPadding
                 height: button.height
-                leftPadding: (modelData.depth - 1) * 10 + 12
+                leftPadding: (model.depth - 1) * 10 + 12
                 rightPadding: 12
 
                 Sky.Button {
@@ -958,11 +995,11 @@ ApplicationWindow {
                     x: parent.leftPadding
                     width: parent.width - parent.rightPadding
                     height: column.implicitHeight + 20
-                    prominence: textArea.currentDocumentSegment === modelData ? Sky.Button.Primary : Sky.Button.Secondary
+                    prominence: textArea.currentDocumentSegment === model.segment ? Sky.Button.Primary : Sky.Button.Secondary
 
                     onClicked: {
                         textArea.suspended = true;
-                        textArea.caretPosition = modelData.position;
+                        textArea.caretPosition = model.segment.position;
                         textArea.suspended = false;
                         verticalScrollbar.centerOnCaret(true);
                     }
@@ -977,7 +1014,7 @@ ApplicationWindow {
                                 id: headingLabel
                                 font.pointSize: 13
                                 width: column.width - segmentWordCount.width
-                                text: modelData.heading === '' ? qsTr('No heading') : modelData.heading
+                                text: model.heading === '' ? qsTr('No heading') : model.heading
 
                             }
                             Sky.Text {
@@ -988,7 +1025,7 @@ ApplicationWindow {
                                 height: headingLabel.height
                                 horizontalAlignment: Qt.AlignRight
                                 verticalAlignment: Qt.AlignBottom
-                                text: qsTr("%L1 words").arg(modelData.totalWordCount)
+                                text: qsTr("%L1 words").arg(model.totalWordCount)
                             }
                         }
 
@@ -996,8 +1033,8 @@ ApplicationWindow {
                             color: Qt.darker(palette.text, 1.15)
                             font.pointSize: 10.5
                             width: parent.width
-                            visible: modelData.subheading !== ''
-                            text: modelData.subheading
+                            visible: model.subheading !== ''
+                            text: model.subheading
                         }
                     }
                 }
@@ -0,0 +1,51 @@
+QT += quick quickcontrols2 quick-private concurrent
+
+CONFIG += c++20 console
+CONFIG -= app_bundle
+
+versionAtLeast(QT_VERSION, 6.0.0) {
+    error(Migration to Qt 6 is still pending for when all relevant APIs are ready. The recommended version to build this project with is 5.14.2. See https://github.com/cengels/skywriter/issues/54 for details.)
+}
+
+versionAtLeast(QT_VERSION, 5.15.0) {
+    error(Qt version 5.15 is unsupported. See https://github.com/cengels/skywriter/issues/54 for details.)
+}
+
+#Application version
+VERSION_MAJOR = 0
+VERSION_MINOR = 0
+VERSION_BUILD = 1
+
+DEFINES += "VERSION_MAJOR=$$VERSION_MAJOR"\
+       "VERSION_MINOR=$$VERSION_MINOR"\
+       "VERSION_BUILD=$$VERSION_BUILD"
+
+#Target version
+VERSION = $${VERSION_MAJOR}.$${VERSION_MINOR}.$${VERSION_BUILD}
+
+# Reuses the editor's text engine without its QML user interface.
+TARGET = skywriter-cli
+
+DEFINES += QT_DEPRECATED_WARNINGS \
+    QT_USE_QSTRINGBUILDER # redefines + into QStringBuilder's more efficient %
+
+HEADERS += \
+        $$files(src/*.h, true) \
+        libs/md4c/src/md4c.h \
+        cli/analysis.h
+
+SOURCES += \
+        $$files(src/*.cpp, true) \
+        libs/md4c/src/md4c.c \
+        cli/analysis.cpp \
+        cli/main.cpp
+SOURCES -= src/main.cpp
+
+INCLUDEPATH += src
+INCLUDEPATH += libs
+DEPENDPATH += src
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
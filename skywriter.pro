@@ -41,23 +41,28 @@ SOURCES += \
         src/Mouse.cpp \
         src/QmlHelper.cpp \
         src/Range.cpp \
+        src/WriteQueue.cpp \
         src/numbers.cpp \
         src/persistence.cpp \
         src/profiling.cpp \
         src/progress/ProgressItem.cpp \
         src/text/DocumentSegment.cpp \
+        src/text/DocumentStructureModel.cpp \
         src/text/FormattableTextArea/actions.cpp \
         src/text/FormattableTextArea/documentstructure.cpp \
         src/text/FormattableTextArea/find.cpp \
         src/text/MarkdownParser.cpp \
+        src/text/PrefixSums.cpp \
         src/text/Replacement.cpp \
         src/text/StringReplacer.cpp \
         src/text/UserData.cpp \
+        src/text/WordCountIndex.cpp \
         src/text/selection.cpp \
         src/text/symbols.cpp \
         src/text/FormattableTextArea/FormattableTextArea.cpp \
         src/text/FormattableTextArea/counter.cpp \
         src/text/FormattableTextArea/keyevents.cpp \
+        src/text/FormattableTextArea/materialization.cpp \
         src/text/FormattableTextArea/mouseevents.cpp \
         src/text/FormattableTextArea/painting.cpp \
         src/text/FormattableTextArea/props.cpp \
@@ -65,6 +70,9 @@ SOURCES += \
         src/text/TextHighlighter.cpp \
         src/text/TextIterator.cpp \
         src/text/format.cpp \
+        src/text/outline.cpp \
+        src/text/searchresults.cpp \
+        src/text/wordcount.cpp \
         src/progress/ProgressTracker.cpp \
         src/theming/HeadingFormat.cpp \
         src/theming/ThemeManager.cpp \
@@ -96,20 +104,27 @@ HEADERS += \
     src/Mouse.h \
     src/QmlHelper.h \
     src/Range.h \
+    src/WriteQueue.h \
     src/numbers.h \
     src/persistence.h \
     src/profiling.h \
     src/progress/ProgressItem.h \
     src/text/DocumentSegment.h \
+    src/text/DocumentStructureModel.h \
     src/text/FormattableTextArea/FormattableTextArea.h \
     src/text/MarkdownParser.h \
+    src/text/PrefixSums.h \
     src/text/Replacement.h \
     src/text/StringReplacer.h \
     src/text/TextFormatter.h \
     src/text/TextHighlighter.h \
     src/text/TextIterator.h \
     src/text/UserData.h \
+    src/text/WordCountIndex.h \
     src/text/format.h \
+    src/text/outline.h \
+    src/text/searchresults.h \
+    src/text/wordcount.h \
     src/progress/ProgressTracker.h \
     src/text/selection.h \
     src/text/symbols.h \
@@ -0,0 +1,76 @@
+#include <QCoreApplication>
+#include <QFile>
+#include <QtConcurrent/QtConcurrent>
+
+#include "WriteQueue.h"
+#include "persistence.h"
+
+WriteQueue::WriteQueue(QObject* parent) : QObject(parent),
+    m_pool(),
+    m_mutex(),
+    m_latestWrites(),
+    m_nextId(0)
+{
+    // A single thread is what guarantees that writes are committed in the
+    // order they were queued.
+    m_pool.setMaxThreadCount(1);
+    m_pool.setExpiryTimeout(-1);
+}
+
+WriteQueue::~WriteQueue()
+{
+    m_pool.waitForDone();
+}
+
+void WriteQueue::enqueue(const QString& fileName, const QStringList& chunks, bool keepBackup, const Callback& callback)
+{
+    const int id = m_nextId++;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_latestWrites.insert(fileName, id);
+    }
+
+    QtConcurrent::run(&m_pool, [this, id, fileName, chunks, keepBackup, callback] {
+        Result result = Committed;
+        QString errorString;
+
+        {
+            QMutexLocker locker(&m_mutex);
+
+            if (m_latestWrites.value(fileName) != id) {
+                result = Superseded;
+            }
+        }
+
+        if (result != Superseded) {
+            QFile file(fileName);
+
+            const bool success = persistence::overwrite(file, static_cast<std::function<bool(QTextStream&)>>([&](QTextStream& stream)
+            {
+                for (const QString& chunk : chunks) {
+                    stream << chunk;
+                }
+
+                return stream.status() == QTextStream::Ok;
+            }), keepBackup);
+
+            if (!success) {
+                result = Failed;
+                errorString = file.errorString();
+            }
+        }
+
+        QMetaObject::invokeMethod(this, [callback, result, errorString] {
+            callback(result, errorString);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void WriteQueue::waitForDone()
+{
+    m_pool.waitForDone();
+
+    // Delivers the callbacks the worker posted to this object.
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
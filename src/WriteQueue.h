@@ -0,0 +1,57 @@
+#ifndef WRITEQUEUE_H
+#define WRITEQUEUE_H
+
+#include <functional>
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+
+/*!
+    Writes files on a background thread without blocking the GUI thread.
+
+    Each write consists of a list of chunks that are written in order into
+    a temporary file, which then replaces the target file (see
+    persistence::overwrite()). Writes are committed in the order they were
+    queued. If a newer write to the same file is queued before an older one
+    has started, the older one is skipped, so an older write can never
+    overwrite a newer one.
+*/
+class WriteQueue : public QObject
+{
+    Q_OBJECT
+
+    public:
+        enum Result {
+            Committed,
+            //! A newer write to the same file was queued before this one
+            //! started, so this write was skipped.
+            Superseded,
+            Failed
+        };
+
+        //! Called on the WriteQueue's thread once a write is done.
+        //! errorString is only set if the write failed.
+        using Callback = std::function<void(Result result, const QString& errorString)>;
+
+        explicit WriteQueue(QObject* parent = nullptr);
+        //! Waits for all queued writes to finish. Their callbacks are not
+        //! invoked anymore.
+        ~WriteQueue();
+
+        //! Queues a write of the chunks into the specified file.
+        void enqueue(const QString& fileName, const QStringList& chunks, bool keepBackup, const Callback& callback);
+        //! Blocks until all queued writes are done and invokes their
+        //! callbacks.
+        void waitForDone();
+
+    private:
+        QThreadPool m_pool;
+        QMutex m_mutex;
+        //! Maps each file name to the id of the latest write queued for it.
+        QHash<QString, int> m_latestWrites;
+        int m_nextId;
+};
+
+#endif // WRITEQUEUE_H
@@ -32,6 +32,7 @@ namespace {
     void registerQmlTypes(QGuiApplication& app)
     {
         qmlRegisterType<FormattableTextArea>("Skywriter.Text", 1, 0, "FormattableTextArea");
+        qmlRegisterUncreatableType<DocumentStructureModel>("Skywriter.Text", 1, 0, "DocumentStructureModel", "Provided by FormattableTextArea.documentStructureModel");
 
         registerSingleton<ProgressTracker>("Skywriter.Progress", 1, 0, "ProgressTracker");
 
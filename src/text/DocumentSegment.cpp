@@ -1,14 +1,26 @@
+#include <QMetaMethod>
 #include <QVector>
+#include <algorithm>
+#include <limits>
 
 #include "UserData.h"
 #include "DocumentSegment.h"
+#include "outline.h"
 #include "symbols.h"
 
 DocumentSegment::DocumentSegment(QObject *parent) : QObject(parent),
     m_position(0),
     m_depth(0),
     m_wordCount(0),
-    m_totalWordCount(0)
+    m_totalWordCount(0),
+    m_index(-1),
+    m_previous(nullptr),
+    m_next(nullptr),
+    m_parent(nullptr),
+    m_children(),
+    m_text(),
+    m_textPosition(-1),
+    m_textRevisions()
 {
 }
 
@@ -16,20 +28,27 @@ DocumentSegment::DocumentSegment(int position, int depth, QObject* parent) : QOb
     m_position(position),
     m_depth(depth),
     m_wordCount(0),
-    m_totalWordCount(0)
+    m_totalWordCount(0),
+    m_index(-1),
+    m_previous(nullptr),
+    m_next(nullptr),
+    m_parent(nullptr),
+    m_children(),
+    m_text(),
+    m_textPosition(-1),
+    m_textRevisions()
 {
 }
 
 int DocumentSegment::position() const
 {
-    return m_position;
-}
+    const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
 
-void DocumentSegment::setPosition(int position)
-{
-    m_position = position;
+    if (textArea && m_index >= 0) {
+        return textArea->segmentPosition(m_index);
+    }
 
-    emit positionChanged();
+    return m_position;
 }
 
 int DocumentSegment::length() const
@@ -43,7 +62,9 @@ int DocumentSegment::length() const
     const DocumentSegment* nextSegment = next();
 
     if (nextSegment) {
-        return nextSegment->position() - position();
+        const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+
+        return textArea->segmentLength(m_index);
     } else {
         return doc->characterCount() - position();
     }
@@ -67,73 +88,240 @@ QString DocumentSegment::text() const
         return QString();
     }
 
-    const QString& text = doc->toPlainText();
+    // Segments always begin at the start of a block, so the text is made up
+    // of the texts of the blocks up to the next segment. The cache remains
+    // valid as long as none of these blocks were edited.
+    const int position = this->position();
+    const int end = position + length();
+    QVector<int> revisions;
 
-    const DocumentSegment* nextSegment = next();
-    int endPosition = nextSegment && nextSegment->isValid() ? nextSegment->position() - m_position : -1;
+    for (QTextBlock block = doc->findBlock(position); block.isValid() && block.position() < end; block = block.next()) {
+        revisions.append(block.revision());
+        revisions.append(block.length());
+    }
 
-    return text.mid(m_position, endPosition);
+    if (m_textPosition == position && m_textRevisions == revisions) {
+        return m_text;
+    }
+
+    QString text;
+    text.reserve(end - position);
+
+    for (QTextBlock block = doc->findBlock(position); block.isValid() && block.position() < end; block = block.next()) {
+        text.append(block.text());
+
+        if (block.next().isValid()) {
+            text.append(QLatin1Char('\n'));
+        }
+    }
+
+    // Same replacements QTextDocument::toPlainText() makes.
+    for (QChar& character : text) {
+        switch (character.unicode()) {
+            case 0xfdd0: // beginning of frame
+            case 0xfdd1: // end of frame
+            case QChar::LineSeparator:
+                character = QLatin1Char('\n');
+                break;
+            case QChar::Nbsp:
+                character = QLatin1Char(' ');
+                break;
+        }
+    }
+
+    m_text = text;
+    m_textPosition = position;
+    m_textRevisions = revisions;
+
+    return m_text;
+}
+
+int DocumentSegment::index() const
+{
+    return m_index;
 }
 
 DocumentSegment* DocumentSegment::next() const
 {
-    if (!parent()) {
-        return nullptr;
-    }
+    return m_next;
+}
 
-    const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+DocumentSegment* DocumentSegment::previous() const
+{
+    return m_previous;
+}
 
-    if (!textArea->document()) {
-        return nullptr;
+DocumentSegment* DocumentSegment::parentSegment() const
+{
+    return m_parent;
+}
+
+const QVector<DocumentSegment*>& DocumentSegment::children() const
+{
+    return m_children;
+}
+
+void DocumentSegment::appendAfter(DocumentSegment* previous)
+{
+    m_previous = previous;
+    m_index = previous ? previous->m_index + 1 : 0;
+
+    if (!previous) {
+        return;
     }
 
-    const int index = this->index();
+    previous->m_next = this;
 
-    if (index == -1 || index == textArea->documentStructure().size() - 1) {
-        return nullptr;
+    // The ancestors of the previous segment are the only candidates for
+    // this segment's parent, since all other segments are followed by one
+    // of the same or a lower depth.
+    DocumentSegment* parent = previous;
+
+    while (parent && parent->m_depth >= m_depth) {
+        parent = parent->m_parent;
     }
 
-    return textArea->documentStructure().at(index + 1);
+    m_parent = parent;
+
+    if (parent) {
+        parent->m_children.append(this);
+    }
 }
 
-DocumentSegment* DocumentSegment::previous() const
+void DocumentSegment::unlink()
 {
-    if (!parent()) {
-        return nullptr;
+    FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+
+    if (textArea) {
+        textArea->observeSegment(this, false);
     }
 
-    const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+    // Keeps the position it had in the structure.
+    m_position = position();
 
-    if (!textArea->document()) {
-        return nullptr;
+    // Parents that were removed as well don't need to be updated.
+    if (m_parent && m_parent->m_index >= 0) {
+        m_parent->m_children.removeOne(this);
+        m_parent->addToTotalWordCount(-m_totalWordCount);
     }
 
-    const int index = this->index();
+    m_index = -1;
+    m_previous = nullptr;
+    m_next = nullptr;
+    m_parent = nullptr;
+    m_children.clear();
+}
 
-    if (index <= 0) {
-        return nullptr;
+void DocumentSegment::connectNotify(const QMetaMethod& signal)
+{
+    if (signal != QMetaMethod::fromSignal(&DocumentSegment::positionChanged)) {
+        return;
     }
 
-    return textArea->documentStructure().at(index - 1);
+    FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+
+    if (textArea && m_index >= 0) {
+        textArea->observeSegment(this, true);
+    }
 }
 
-DocumentSegment* DocumentSegment::parentSegment() const
+void DocumentSegment::disconnectNotify(const QMetaMethod& signal)
 {
-    DocumentSegment* segment = previous();
+    // An invalid signal means that everything was disconnected at once.
+    if (signal.isValid() && signal != QMetaMethod::fromSignal(&DocumentSegment::positionChanged)) {
+        return;
+    }
 
-    if (segment == nullptr) {
-        return nullptr;
+    FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+
+    if (textArea && !isSignalConnected(QMetaMethod::fromSignal(&DocumentSegment::positionChanged))) {
+        textArea->observeSegment(this, false);
+    }
+}
+
+void DocumentSegment::link(const QVector<DocumentSegment*>& structure, const int first, const int until, const QVector<DocumentSegment*>& removed)
+{
+    // The parent of a following segment can only have changed if a segment
+    // of a lower depth was removed or inserted in front of it.
+    int depth = std::numeric_limits<int>::max();
+
+    for (const DocumentSegment* segment : removed) {
+        depth = qMin(depth, segment->m_depth);
+    }
+
+    for (int i = first; i < until; i++) {
+        depth = qMin(depth, structure.at(i)->m_depth);
+    }
+
+    // These are the following segments that aren't preceded by a segment of
+    // a lower depth before the splice. Once one of them doesn't have a
+    // greater depth than the spliced segments, the parents of all segments
+    // after it are found before reaching the splice.
+    QVector<DocumentSegment*> reparented;
+    int lowestDepth = std::numeric_limits<int>::max();
+
+    for (int i = until; i < structure.size() && lowestDepth > depth; i++) {
+        DocumentSegment* segment = structure.at(i);
+
+        if (segment->m_depth <= lowestDepth) {
+            lowestDepth = segment->m_depth;
+
+            if (segment->m_depth > depth) {
+                reparented.append(segment);
+            }
+        }
+    }
+
+    for (DocumentSegment* segment : reparented) {
+        DocumentSegment* parent = segment->m_parent;
+
+        // Removed parents were already unlinked.
+        if (parent && parent->m_index >= 0) {
+            parent->m_children.removeOne(segment);
+            parent->addToTotalWordCount(-segment->m_totalWordCount);
+        }
+
+        segment->m_parent = nullptr;
+    }
+
+    // The indices of the following segments only need to be updated if the
+    // number of segments changed.
+    for (int i = first; i < structure.size() && (i < until || structure.at(i)->m_index != i); i++) {
+        structure.at(i)->m_index = i;
+    }
+
+    for (int i = qMax(first - 1, 0); i <= until && i < structure.size(); i++) {
+        DocumentSegment* segment = structure.at(i);
+        segment->m_previous = i > 0 ? structure.at(i - 1) : nullptr;
+        segment->m_next = i < structure.size() - 1 ? structure.at(i + 1) : nullptr;
     }
 
-    while (segment->m_depth >= this->m_depth) {
-        segment = segment->previous();
+    // Same as in appendAfter(), except that the parent may already have
+    // children following the segment.
+    const auto attach = [](DocumentSegment* segment) {
+        DocumentSegment* parent = segment->m_previous;
 
-        if (segment == nullptr) {
-            return nullptr;
+        while (parent && parent->m_depth >= segment->m_depth) {
+            parent = parent->m_parent;
         }
+
+        segment->m_parent = parent;
+
+        if (parent) {
+            const auto next = std::upper_bound(parent->m_children.begin(), parent->m_children.end(), segment->m_index,
+                                               [](const int index, const DocumentSegment* child) { return index < child->m_index; });
+            parent->m_children.insert(next, segment);
+            parent->addToTotalWordCount(segment->m_totalWordCount);
+        }
+    };
+
+    for (int i = first; i < until; i++) {
+        attach(structure.at(i));
     }
 
-    return segment;
+    for (DocumentSegment* segment : reparented) {
+        attach(segment);
+    }
 }
 
 QTextDocument* DocumentSegment::document() const
@@ -149,24 +337,12 @@ QTextDocument* DocumentSegment::document() const
 
 QString DocumentSegment::heading() const
 {
-    const QTextBlock block = document()->findBlock(m_position);
-
-    if (block.blockFormat().headingLevel() == 0) {
-        return QString();
-    }
-
-    return block.text();
+    return outline::heading(document()->findBlock(position()));
 }
 
 QString DocumentSegment::subheading() const
 {
-    QTextBlock block = document()->findBlock(m_position).next();
-
-    if (block.blockFormat().headingLevel() == 0 || block.blockFormat().headingLevel() % 2 != 0) {
-        return QString();
-    }
-
-    return block.text();
+    return outline::subheading(document()->findBlock(position()));
 }
 
 int DocumentSegment::depth() const
@@ -182,26 +358,9 @@ bool DocumentSegment::isValid() const
         return false;
     }
 
-    return m_position > 0 && m_position < doc->characterCount() && m_depth > 0;
-}
-
-int DocumentSegment::index() const
-{
-    if (!parent()) {
-        return -1;
-    }
-
-    const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
-
-    // Can't use indexOf here due to an incomprehensible compiler error.
-    int size = textArea->documentStructure().size();
-    for (int i = 0; i < size; i++) {
-        if (textArea->documentStructure().at(i) == this) {
-            return i;
-        }
-    }
+    const int position = this->position();
 
-    return -1;
+    return position > 0 && position < doc->characterCount() && m_depth > 0;
 }
 
 QTextBlock DocumentSegment::firstBlock() const
@@ -228,71 +387,44 @@ QTextBlock DocumentSegment::lastBlock() const
 
 void DocumentSegment::updateWordCount()
 {
-    QTextBlock block = this->firstBlock();
-    int end = this->position() + this->length();
+    const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
+    const QTextBlock first = this->firstBlock();
+    const QTextBlock last = this->lastBlock();
 
     int previous = m_wordCount;
     m_wordCount = 0;
 
-    while (block.isValid() && block.position() < end) {
-        m_wordCount += UserData::fromBlock(block).wordCount();
-        block = block.next();
+    if (textArea && first.isValid() && last.isValid()) {
+        m_wordCount = textArea->wordCountIndex().wordCount(first.blockNumber(), last.blockNumber() + 1);
     }
 
     if (m_wordCount != previous) {
         emit wordCountChanged();
 
-        updateTotalWordCount();
+        addToTotalWordCount(m_wordCount - previous);
     }
 }
 
 void DocumentSegment::updateTotalWordCount()
 {
-    int previous = m_totalWordCount;
-
-    m_totalWordCount = m_wordCount;
+    int total = m_wordCount;
 
-    if (!parent()) {
-        emit totalWordCountChanged();
-        return;
+    for (const DocumentSegment* child : m_children) {
+        total += child->m_totalWordCount;
     }
 
-    const FormattableTextArea* textArea = qobject_cast<FormattableTextArea*>(parent());
-
-    bool reachedSelf = false;
-    int targetDepth = -1;
-
-    int size = textArea->documentStructure().size();
-    for (int i = 0; i < size; i++) {
-        auto segment = textArea->documentStructure().at(i);
-
-        if (reachedSelf) {
-            if (targetDepth == -1) {
-                if (segment->m_depth <= this->m_depth) {
-                    break;
-                } else {
-                    targetDepth = segment->m_depth;
-                }
-            } else if (segment->m_depth < targetDepth) {
-                break;
-            }
+    addToTotalWordCount(total - m_totalWordCount);
+}
 
-            if (segment->m_depth == targetDepth) {
-                m_totalWordCount += segment->m_totalWordCount;
-            }
-        } else if (segment == this) {
-            reachedSelf = true;
-        }
+void DocumentSegment::addToTotalWordCount(int difference)
+{
+    if (difference == 0) {
+        return;
     }
 
-    if (previous != m_totalWordCount) {
-        emit totalWordCountChanged();
-
-        DocumentSegment* parentSegment = this->parentSegment();
-
-        if (parentSegment) {
-            parentSegment->updateTotalWordCount();
-        }
+    for (DocumentSegment* segment = this; segment; segment = segment->m_parent) {
+        segment->m_totalWordCount += difference;
+        emit segment->totalWordCountChanged();
     }
 }
 
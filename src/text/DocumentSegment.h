@@ -9,7 +9,7 @@
 class DocumentSegment : public QObject
 {
     Q_OBJECT
-    Q_PROPERTY(int position READ position WRITE setPosition NOTIFY positionChanged)
+    Q_PROPERTY(int position READ position NOTIFY positionChanged)
     Q_PROPERTY(QString text READ text NOTIFY textChanged)
     Q_PROPERTY(int wordCount READ wordCount NOTIFY wordCountChanged)
     Q_PROPERTY(int totalWordCount READ totalWordCount NOTIFY totalWordCountChanged)
@@ -24,12 +24,20 @@ class DocumentSegment : public QObject
         //! Gets the text index where the DocumentSegment begins.
         //! The DocumentSegment runs until the the next DocumentSegment's
         //! position() or until the end of the document.
+        //!
+        //! Segments that are part of a document structure don't store their
+        //! position, but look it up from the segment lengths kept by the
+        //! FormattableTextArea, so that edits don't need to touch every
+        //! following segment. positionChanged() is only emitted for segments
+        //! that something is connected to.
         int position() const;
-        void setPosition(int position);
 
         int length() const;
 
-        //! Gets the text contained in this DocumentSegment.
+        //! Gets the text contained in this DocumentSegment, in the same form
+        //! QTextDocument::toPlainText() returns it. Only the blocks of this
+        //! segment are read, and the result is cached until one of them
+        //! changes.
         QString text() const;
         //! Gets the number of words of the text within this DocumentSegment.
         int wordCount() const;
@@ -50,9 +58,30 @@ class DocumentSegment : public QObject
         //! combined.
         int depth() const;
 
+        //! Gets the index of the DocumentSegment within the document
+        //! structure, or -1 if it isn't part of one.
+        int index() const;
         DocumentSegment* next() const;
         DocumentSegment* previous() const;
+        //! Gets the closest preceding DocumentSegment with a lower depth.
         DocumentSegment* parentSegment() const;
+        //! Gets all DocumentSegments whose parentSegment() is this one.
+        const QVector<DocumentSegment*>& children() const;
+
+        //! Links the DocumentSegment into the document structure as the new
+        //! last segment, directly after the previous one (which may be null
+        //! for the first segment). The parent is determined from the depths
+        //! of the previous segment and its ancestors.
+        void appendAfter(DocumentSegment* previous);
+        //! Links the segments from index first until index until (exclusive)
+        //! into the document structure after they replaced the removed
+        //! segments, which must have been unlinked already. Only the segments
+        //! next to the splice and the following segments whose parent may
+        //! have changed are relinked. The inserted segments must be new.
+        static void link(const QVector<DocumentSegment*>& structure, int first, int until, const QVector<DocumentSegment*>& removed);
+        //! Removes the DocumentSegment from the document structure. Its total
+        //! word count is subtracted from its ancestors.
+        void unlink();
 
         //! Gets the QTextDocument this DocumentSegment corresponds to.
         QTextDocument* document() const;
@@ -67,8 +96,11 @@ class DocumentSegment : public QObject
         //! Gets the last text block contained in the DocumentSegment.
         QTextBlock lastBlock() const;
 
-        //! Updates the word count of the DocumentSegment.
+        //! Updates the word count of the DocumentSegment. Any difference is
+        //! added to the total word counts of this segment and its ancestors.
         void updateWordCount();
+        //! Recalculates the total word count from this segment's word count
+        //! and its children's total word counts.
         void updateTotalWordCount();
 
         bool operator==(const DocumentSegment& other) const;
@@ -76,6 +108,10 @@ class DocumentSegment : public QObject
         bool operator!=(const DocumentSegment& other) const;
         bool operator!=(const DocumentSegment* other) const;
 
+    protected:
+        void connectNotify(const QMetaMethod& signal) override;
+        void disconnectNotify(const QMetaMethod& signal) override;
+
     Q_SIGNALS:
         void positionChanged();
         void textChanged();
@@ -83,12 +119,27 @@ class DocumentSegment : public QObject
         void totalWordCountChanged();
 
     private:
+        //! The position of a segment that is not part of a document structure.
         int m_position;
         int m_depth;
         int m_wordCount;
         int m_totalWordCount;
 
-        int index() const;
+        int m_index;
+        DocumentSegment* m_previous;
+        DocumentSegment* m_next;
+        DocumentSegment* m_parent;
+        QVector<DocumentSegment*> m_children;
+
+        //! The text as of the last call of text().
+        mutable QString m_text;
+        mutable int m_textPosition;
+        //! The revision and length of each block m_text was built from.
+        mutable QVector<int> m_textRevisions;
+
+        //! Adds the difference to the total word counts of this segment and
+        //! all its ancestors.
+        void addToTotalWordCount(int difference);
 };
 
 #endif // DOCUMENTSEGMENT_H
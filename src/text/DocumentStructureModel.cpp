@@ -0,0 +1,143 @@
+#include "DocumentStructureModel.h"
+#include "DocumentSegment.h"
+
+DocumentStructureModel::DocumentStructureModel(QObject* parent) : QAbstractListModel(parent),
+    m_segments()
+{
+}
+
+int DocumentStructureModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return m_segments.size();
+}
+
+QVariant DocumentStructureModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_segments.size()) {
+        return QVariant();
+    }
+
+    DocumentSegment* segment = m_segments.at(index.row());
+
+    switch (role) {
+        case SegmentRole:
+            return QVariant::fromValue(segment);
+        case Qt::DisplayRole:
+        case HeadingRole:
+            return segment->heading();
+        case SubheadingRole:
+            return segment->subheading();
+        case DepthRole:
+            return segment->depth();
+        case WordCountRole:
+            return segment->wordCount();
+        case TotalWordCountRole:
+            return segment->totalWordCount();
+        default:
+            return QVariant();
+    }
+}
+
+QHash<int, QByteArray> DocumentStructureModel::roleNames() const
+{
+    return {
+        { SegmentRole, "segment" },
+        { HeadingRole, "heading" },
+        { SubheadingRole, "subheading" },
+        { DepthRole, "depth" },
+        { WordCountRole, "wordCount" },
+        { TotalWordCountRole, "totalWordCount" }
+    };
+}
+
+int DocumentStructureModel::indexOf(QObject* segment) const
+{
+    DocumentSegment* documentSegment = qobject_cast<DocumentSegment*>(segment);
+
+    if (!documentSegment) {
+        return -1;
+    }
+
+    // Segments know their index, which is the same as their row as long as
+    // the model is in step with the document structure.
+    const int row = documentSegment->index();
+
+    return row >= 0 && m_segments.value(row) == documentSegment ? row : m_segments.indexOf(documentSegment);
+}
+
+void DocumentStructureModel::reset(const QVector<DocumentSegment*>& segments)
+{
+    beginResetModel();
+
+    for (DocumentSegment* segment : m_segments) {
+        unwatch(segment);
+    }
+
+    m_segments = segments;
+
+    for (DocumentSegment* segment : m_segments) {
+        watch(segment);
+    }
+
+    endResetModel();
+}
+
+void DocumentStructureModel::splice(int first, int removed, const QVector<DocumentSegment*>& segments)
+{
+    if (removed > 0) {
+        beginRemoveRows(QModelIndex(), first, first + removed - 1);
+
+        for (int i = first; i < first + removed; i++) {
+            unwatch(m_segments.at(i));
+        }
+
+        m_segments.remove(first, removed);
+        endRemoveRows();
+    }
+
+    if (!segments.isEmpty()) {
+        beginInsertRows(QModelIndex(), first, first + segments.size() - 1);
+
+        for (int i = 0; i < segments.size(); i++) {
+            m_segments.insert(first + i, segments.at(i));
+            watch(segments.at(i));
+        }
+
+        endInsertRows();
+    }
+}
+
+void DocumentStructureModel::watch(DocumentSegment* segment)
+{
+    connect(segment, &DocumentSegment::textChanged, this, [this, segment] {
+        // The heading and subheading are part of the segment's text.
+        segmentChanged(segment, { Qt::DisplayRole, HeadingRole, SubheadingRole });
+    });
+    connect(segment, &DocumentSegment::wordCountChanged, this, [this, segment] {
+        segmentChanged(segment, { WordCountRole });
+    });
+    connect(segment, &DocumentSegment::totalWordCountChanged, this, [this, segment] {
+        segmentChanged(segment, { TotalWordCountRole });
+    });
+}
+
+void DocumentStructureModel::unwatch(DocumentSegment* segment)
+{
+    disconnect(segment, nullptr, this, nullptr);
+}
+
+void DocumentStructureModel::segmentChanged(DocumentSegment* segment, const QVector<int>& roles)
+{
+    const int row = indexOf(segment);
+
+    if (row < 0) {
+        return;
+    }
+
+    const QModelIndex modelIndex = index(row);
+    emit dataChanged(modelIndex, modelIndex, roles);
+}
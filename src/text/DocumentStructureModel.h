@@ -0,0 +1,54 @@
+#ifndef DOCUMENTSTRUCTUREMODEL_H
+#define DOCUMENTSTRUCTUREMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+class DocumentSegment;
+
+//! A flat list model of the document structure, in which each row is a
+//! DocumentSegment and its place in the hierarchy is given by the depth
+//! role. Unlike the documentStructure property, the model is only reset if
+//! the entire structure is rebuilt. Spliced segments are inserted and
+//! removed as rows, and changes to a segment only emit dataChanged() for
+//! the roles that changed.
+class DocumentStructureModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    public:
+        enum Role {
+            SegmentRole = Qt::UserRole + 1,
+            HeadingRole,
+            SubheadingRole,
+            DepthRole,
+            WordCountRole,
+            TotalWordCountRole
+        };
+        Q_ENUM(Role)
+
+        explicit DocumentStructureModel(QObject* parent = nullptr);
+
+        int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+        QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+        QHash<int, QByteArray> roleNames() const override;
+
+        //! Gets the row of the segment, or -1 if it is not in the model.
+        Q_INVOKABLE int indexOf(QObject* segment) const;
+
+        //! Replaces all segments and resets the model.
+        void reset(const QVector<DocumentSegment*>& segments);
+        //! Removes the specified number of rows starting at first and
+        //! inserts the segments in their place.
+        void splice(int first, int removed, const QVector<DocumentSegment*>& segments);
+
+    private:
+        QVector<DocumentSegment*> m_segments;
+
+        void watch(DocumentSegment* segment);
+        void unwatch(DocumentSegment* segment);
+        //! Emits dataChanged() for the segment's row, if it has one.
+        void segmentChanged(DocumentSegment* segment, const QVector<int>& roles);
+};
+
+#endif // DOCUMENTSTRUCTUREMODEL_H
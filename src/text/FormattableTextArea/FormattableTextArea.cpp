@@ -1,8 +1,12 @@
 #include <QCursor>
 #include <QAbstractTextDocumentLayout>
 #include <QQmlFile>
-#include <QTextCodec>
 #include <QFileInfo>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QPointer>
+#include <QtConcurrent/QtConcurrent>
+#include <cctype>
 
 #include "FormattableTextArea.h"
 #include "../symbols.h"
@@ -11,23 +15,237 @@
 #include "../../ErrorManager.h"
 #include "../UserData.h"
 
+namespace {
+    //! Markdown files smaller than this are always parsed in their entirety
+    //! before they are swapped in.
+    constexpr qint64 LAZY_LOADING_THRESHOLD = 1024 * 1024;
+    //! The amount of markdown that is parsed before a large file is swapped
+    //! in. Parsing always stops at a heading.
+    constexpr qint64 INITIAL_CHUNK_SIZE = 256 * 1024;
+    //! The minimum amount of markdown that is parsed at once while the rest
+    //! of a large file is appended in the background.
+    constexpr qint64 CHUNK_SIZE = 64 * 1024;
+    //! The longest time statistics may lag behind an edit, in milliseconds.
+    //! All edits made within this time are processed together.
+    constexpr int CHANGE_PROCESSING_DELAY = 16;
+
+    //! Maps a position from before a change to the position the same
+    //! character has after the change. Positions inside removed text are
+    //! mapped to the end of the added text.
+    int mapThroughChange(const int position, const int changePosition, const int removed, const int added)
+    {
+        if (position <= changePosition) {
+            return position;
+        }
+
+        if (position < changePosition + removed) {
+            return changePosition + added;
+        }
+
+        return position + added - removed;
+    }
+
+    //! Extends the range of changed text, which may be invalid if nothing
+    //! changed so far, by another change. If text was only removed, the
+    //! block it was removed from still needs to be looked at again, so the
+    //! range always contains at least one character.
+    Range<int> addChange(const Range<int>& range, const int position, const int removed, const int added)
+    {
+        const int changeEnd = position + qMax(added, 1);
+
+        if (!range.isValid()) {
+            return Range<int>(position, changeEnd);
+        }
+
+        return Range<int>(
+            qMin(mapThroughChange(range.from(), position, removed, added), position),
+            qMax(mapThroughChange(range.until(), position, removed, added), changeEnd)
+        );
+    }
+
+    struct LoadResult {
+        QTextDocument* document;
+        QVector<FormattableTextArea::PendingChunk> pendingChunks;
+    };
+
+    //! Estimates the number of words in raw markdown by counting the
+    //! whitespace-separated tokens that contain at least one letter, digit
+    //! or non-ASCII character. This skips most markup (heading marks, scene
+    //! breaks), but does not apply all rules TextIterator does.
+    int estimateWordCount(const char* data, qint64 size)
+    {
+        int words = 0;
+        bool inToken = false;
+        bool tokenIsWord = false;
+
+        for (qint64 i = 0; i < size; i++) {
+            const uchar character = uchar(data[i]);
+
+            if (character == ' ' || character == '\n' || character == '\r' || character == '\t') {
+                words += tokenIsWord;
+                inToken = false;
+                tokenIsWord = false;
+            } else {
+                inToken = true;
+                tokenIsWord = tokenIsWord || character >= 0x80 || std::isalnum(character);
+            }
+        }
+
+        return words + (inToken && tokenIsWord);
+    }
+
+    //! Returns the offsets at which large markdown files are split into
+    //! chunks. The first offset marks the end of the initial chunk.
+    QVector<qint64> chunkBoundaries(const char* data, qint64 size)
+    {
+        QVector<qint64> boundaries;
+
+        if (size < LAZY_LOADING_THRESHOLD) {
+            return boundaries;
+        }
+
+        qint64 next = INITIAL_CHUNK_SIZE;
+
+        for (const qint64 offset : MarkdownParser::headingOffsets(data, size)) {
+            if (offset >= next) {
+                boundaries.append(offset);
+                next = offset + CHUNK_SIZE;
+            }
+        }
+
+        return boundaries;
+    }
+
+    //! Reads the file and constructs a new QTextDocument from its contents.
+    //! This function is meant to be run on a worker thread. The document is
+    //! not parented and is moved to the target thread before it is returned.
+    //! The document is nullptr if the file cannot be read or the load was
+    //! cancelled.
+    //!
+    //! Large markdown files are only parsed up to the first heading past
+    //! INITIAL_CHUNK_SIZE. The rest is returned as pending chunks.
+    LoadResult readDocument(const QString& fileName,
+                                const QFont& font,
+                                const QTextOption& textOption,
+                                const MarkdownParser::BlockFormats& blockFormats,
+                                QThread* targetThread,
+                                const QAtomicInt* cancelled)
+    {
+        QFile file(fileName);
+
+        if (!file.open(QFile::ReadOnly)) {
+            return { nullptr, {} };
+        }
+
+        // The file is memory-mapped rather than read so that the only full
+        // copy of the manuscript in memory is the document itself. If the
+        // file can't be mapped (e.g. an empty or compressed resource file),
+        // it is read into a buffer instead.
+        const qint64 fileSize = file.size();
+        uchar* mapped = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+        QByteArray buffer;
+
+        if (!mapped) {
+            buffer = file.readAll();
+        }
+
+        const char* data = mapped ? reinterpret_cast<const char*>(mapped) : buffer.constData();
+        qint64 size = mapped ? fileSize : buffer.size();
+
+        if (size >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') {
+            // Skip the UTF-8 byte order mark.
+            data += 3;
+            size -= 3;
+        }
+
+        const QString fileType = QFileInfo(file).suffix();
+
+        // No layout is created for the document here. The layout is created
+        // lazily once the document is first painted on the GUI thread.
+        QTextDocument* document = new QTextDocument();
+        document->setUndoRedoEnabled(false);
+        document->setDefaultFont(font);
+        document->setDefaultTextOption(textOption);
+
+        QVector<FormattableTextArea::PendingChunk> pendingChunks;
+
+        if (fileType == persistence::format_markdown) {
+            const QVector<qint64> boundaries = chunkBoundaries(data, size);
+
+            MarkdownParser parser(document, blockFormats);
+            parser.setCancellationFlag(cancelled);
+            parser.parse(data, boundaries.isEmpty() ? size : boundaries.first());
+
+            // The chunks are copied because the file is unmapped below.
+            for (int i = 0; i < boundaries.size(); i++) {
+                const qint64 from = boundaries.at(i);
+                const qint64 until = i + 1 < boundaries.size() ? boundaries.at(i + 1) : size;
+
+                pendingChunks.append({
+                    QByteArray(data + from, int(until - from)),
+                    estimateWordCount(data + from, until - from)
+                });
+            }
+        } else {
+            document->setPlainText(QString::fromUtf8(data, int(size)));
+        }
+
+        if (mapped) {
+            file.unmap(mapped);
+        }
+
+        if (cancelled->loadRelaxed() != 0) {
+            delete document;
+
+            return { nullptr, {} };
+        }
+
+        document->setUndoRedoEnabled(true);
+        document->setModified(false);
+        document->moveToThread(targetThread);
+
+        return { document, pendingChunks };
+    }
+}
+
 FormattableTextArea::FormattableTextArea(QQuickItem *parent)
     : QQuickItem(parent)
     , m_document(nullptr)
     , m_documentStructure(QVector<DocumentSegment*>())
+    , m_documentStructureModel(new DocumentStructureModel(this))
+    , m_segmentLengths()
+    , m_observedSegments()
+    , m_segmentPositionsChangedFrom(-1)
     , m_currentDocumentSegment(nullptr)
     , m_formatter(nullptr)
     , m_highlighter(new TextHighlighter(this))
     , m_replacer(StringReplacer())
+    , m_writeQueue(new WriteQueue(this))
     , m_textCursor(QTextCursor())
     , m_contentY(0.0)
     , m_overflowArea(0.0)
     , m_fileUrl()
+    , m_pendingFileUrl()
+    , m_loadCancellation()
+    , m_pendingChunks()
+    , m_pendingWordCount(0)
+    , m_materializedChunkCount(0)
+    , m_pendingCountCancellation()
+    , m_materializationTimer(this)
+    , m_undoBarrier(0)
+    , m_dirtyRange()
+    , m_searchResultsOffset(0)
+    , m_changeTimer(this)
     , m_loading(false)
     , m_isUndoRedo(false)
     , m_characterCount(0)
     , m_selectedCharacterCount(0)
     , m_wordCount(0)
+    , m_countingWords(false)
+    , m_wordCountRules(wordcount::Rules::Standard)
+    , m_wordCountGeneration(0)
+    , m_wordCountDirtyRange()
+    , m_wordCountOffset(0)
     , m_selectedWordCount(0)
     , m_paragraphCount(0)
     , m_selectedParagraphCount(0)
@@ -35,12 +253,16 @@ FormattableTextArea::FormattableTextArea(QQuickItem *parent)
     , m_selectedPageCount(0)
     , m_searchString()
     , m_searchFlags()
+    , m_searching(false)
+    , m_searchResultCountBeforeSearch(0)
+    , m_searchCancellation()
+    , m_searchEditedRange()
+    , m_searchEditOffset(0)
     , m_underline(false)
     , m_caretTimer(this)
     , m_blinking(false)
     , m_lastMouseUpEvent(QMouseEvent(QMouseEvent::None, QPointF(), Qt::NoButton, 0, 0))
     , m_lastMouseDownEvent(QMouseEvent(QMouseEvent::None, QPointF(), Qt::NoButton, 0, 0))
-    , m_lastCaretPosition(0)
     , m_selectionMode(SelectionMode::NoSelection)
 {
     // Ideally, we would retrieve the system-wide caret blink rate here.
@@ -77,29 +299,44 @@ FormattableTextArea::FormattableTextArea(QQuickItem *parent)
 
     connect(this, &FormattableTextArea::selectedTextChanged, this, &FormattableTextArea::updateSelectedCounts);
     connect(this, &FormattableTextArea::caretPositionChanged, this, [&] {
-        const int characterCount = m_document->characterCount();
-        DocumentSegment* oldSegment = findDocumentSegment(m_lastCaretPosition >= characterCount ? characterCount - 1 : m_lastCaretPosition);
-        DocumentSegment* newSegment = findDocumentSegment(m_textCursor.position());
+        DocumentSegment* newSegment = findDocumentSegment(m_textCursor.block());
 
-        if (oldSegment != newSegment) {
+        if (m_currentDocumentSegment != newSegment) {
             m_currentDocumentSegment = newSegment;
             emit currentDocumentSegmentChanged();
         }
-
-        m_lastCaretPosition = m_textCursor.position();
     });
     connect(m_highlighter, &TextHighlighter::needsRepaint, this, &FormattableTextArea::update);
 
+    // Pending chunks are appended one at a time whenever the event loop is
+    // idle, so that the document remains responsive in the meantime.
+    m_materializationTimer.setInterval(0);
+    m_materializationTimer.callOnTimeout(this, &FormattableTextArea::materializeNext);
+
+    // Statistics are recalculated at most once per frame instead of after
+    // every keystroke. The timer is not restarted by further edits, so they
+    // never lag behind by more than CHANGE_PROCESSING_DELAY.
+    m_changeTimer.setSingleShot(true);
+    m_changeTimer.setInterval(CHANGE_PROCESSING_DELAY);
+    m_changeTimer.callOnTimeout(this, &FormattableTextArea::processChanges);
+
     newDocument();
     connectDocument();
 }
 
+FormattableTextArea::~FormattableTextArea()
+{
+    cancelLoad();
+    cancelSearch();
+}
+
 QTextDocument* FormattableTextArea::newDocument()
 {
     if (m_document) {
         m_document->disconnect(this);
     }
 
+    discardPendingChunks();
     m_document = new QTextDocument(this);
 
     this->updateDocumentDefaults(false);
@@ -110,6 +347,17 @@ QTextDocument* FormattableTextArea::newDocument()
 
 void FormattableTextArea::connectDocument()
 {
+    // Changes to the previous document no longer need to be processed.
+    m_changeTimer.stop();
+    m_dirtyRange = Range<int>();
+    m_searchResultsOffset = 0;
+
+    // Matches found in the previous document are of no use anymore.
+    if (m_searching) {
+        cancelSearch();
+        finishSearching();
+    }
+
     if (m_document) {
         connect(m_document->documentLayout(), &QAbstractTextDocumentLayout::documentSizeChanged, this, [&] {
             emit contentHeightChanged();
@@ -120,7 +368,10 @@ void FormattableTextArea::connectDocument()
         // so we need to place the connect calls in this order.
         connect(m_document, &QTextDocument::modificationChanged, this, &FormattableTextArea::modifiedChanged);
         connect(m_document, &QTextDocument::contentsChange, this, &FormattableTextArea::handleTextChange);
-        connect(m_document, &QTextDocument::undoAvailable, this, &FormattableTextArea::canUndoChanged);
+        // Undo may be unavailable despite the document having undo steps
+        // (see m_undoBarrier).
+        connect(m_document, &QTextDocument::undoAvailable, this, [&] { emit canUndoChanged(canUndo()); });
+        connect(m_document, &QTextDocument::undoCommandAdded, this, [&] { emit canUndoChanged(canUndo()); });
         connect(m_document, &QTextDocument::redoAvailable, this, &FormattableTextArea::canRedoChanged);
 
         if (m_formatter) {
@@ -129,13 +380,16 @@ void FormattableTextArea::connectDocument()
             m_formatter = new TextFormatter(m_document);
             connect(m_formatter, &TextFormatter::blockInvalidated, this, [&] (QTextBlock block) -> void {
                 countWords(block.position(), block.length());
+                const bool wasLoading = m_loading;
                 m_loading = true;
-                findDocumentSegment(block.position())->updateWordCount();
-                m_loading = false;
+                findDocumentSegment(block)->updateWordCount();
+                m_loading = wasLoading;
             });
         }
 
-        countWords(0, m_document->characterCount());
+        countAllWords();
+    } else {
+        m_wordCountIndex.clear();
     }
 
     // must be called before emitting caretPositionChanged()
@@ -159,19 +413,112 @@ void FormattableTextArea::connectDocument()
 
 void FormattableTextArea::handleTextChange(const int position, const int removed, const int added)
 {
+    MarkdownParser::invalidate(m_document, position, added);
+    shiftWordCountIndex(position);
+
     if (m_loading) {
         return;
     }
 
     if (added != 0 || removed != 0) {
-        updateCounts();
-        updateFindRanges();
-        countWords(position, added + removed);
+        if (m_countingWords) {
+            m_wordCountDirtyRange = addChange(m_wordCountDirtyRange, position, removed, added);
+            m_wordCountOffset += added - removed;
+        }
+
+        if (m_searching) {
+            // Whole blocks, since matches never cross block boundaries.
+            const Range<int> edited = addChange(m_searchEditedRange, position, removed, added);
+            const QTextBlock lastBlock = m_document->findBlock(edited.until() - 1);
+
+            m_searchEditedRange = Range<int>(
+                m_document->findBlock(edited.from()).position(),
+                lastBlock.isValid() ? lastBlock.position() + lastBlock.length() : m_document->characterCount()
+            );
+            m_searchEditOffset += added - removed;
+        }
+
+        // Segment positions are kept up to date immediately since the caret
+        // relies on them. Everything else waits for processChanges().
         updateDocumentStructure(position, added, removed);
+        scheduleChange(position, removed, added);
         emit textChanged(position, added, removed);
     }
 }
 
+void FormattableTextArea::scheduleChange(const int position, const int removed, const int added)
+{
+    m_dirtyRange = addChange(m_dirtyRange, position, removed, added);
+
+    m_searchResultsOffset += added - removed;
+
+    if (!m_changeTimer.isActive()) {
+        m_changeTimer.start();
+    }
+}
+
+void FormattableTextArea::processChanges()
+{
+    m_changeTimer.stop();
+
+    if (!m_dirtyRange.isValid() || !m_document) {
+        m_dirtyRange = Range<int>();
+        m_searchResultsOffset = 0;
+        m_segmentPositionsChangedFrom = -1;
+        return;
+    }
+
+    const Range<int> dirtyRange = m_dirtyRange;
+    const int searchResultsOffset = m_searchResultsOffset;
+    m_dirtyRange = Range<int>();
+    m_searchResultsOffset = 0;
+
+    updateCounts();
+    countWords(dirtyRange.from(), dirtyRange.length());
+
+    // Prevent each individual call of segment->updateWordCount()
+    // from calling FormattableTextArea::updateWordCount()
+    const bool wasLoading = m_loading;
+    m_loading = true;
+
+    const int segmentCount = m_documentStructure.size();
+
+    for (int i = qMax(m_segmentLengths.indexOf(dirtyRange.from()), 0); i < segmentCount; i++) {
+        DocumentSegment* segment = m_documentStructure.at(i);
+
+        if (segment->position() >= dirtyRange.until()) {
+            break;
+        }
+
+        emit segment->textChanged();
+        segment->updateWordCount();
+    }
+
+    m_loading = wasLoading;
+    updateWordCount();
+    updateFindRanges(dirtyRange, searchResultsOffset);
+
+    if (m_textCursor.hasSelection()) {
+        // Counted from the block counts, which may have been outdated when
+        // the selection last changed.
+        updateSelectedWordCount();
+    }
+
+    if (m_segmentPositionsChangedFrom >= 0) {
+        // Positions are looked up whenever they are read, so only those who
+        // are actually watching need to be told that they changed.
+        const QSet<DocumentSegment*> observedSegments = m_observedSegments;
+
+        for (DocumentSegment* segment : observedSegments) {
+            if (segment->index() >= m_segmentPositionsChangedFrom) {
+                emit segment->positionChanged();
+            }
+        }
+
+        m_segmentPositionsChangedFrom = -1;
+    }
+}
+
 void FormattableTextArea::updateActive()
 {
     m_blinking = false;
@@ -190,9 +537,9 @@ void FormattableTextArea::clearReplacements()
     m_replacer.clear();
 }
 
-void FormattableTextArea::load(const QUrl &fileUrl)
+void FormattableTextArea::load(const QUrl &fileUrl, const WordCountRules rules)
 {
-    if (fileUrl == m_fileUrl)
+    if (fileUrl == m_fileUrl || (m_loading && fileUrl == m_pendingFileUrl))
         return;
 
     const QString fileName = QQmlFile::urlToLocalFileOrQrc(fileUrl);
@@ -201,73 +548,159 @@ void FormattableTextArea::load(const QUrl &fileUrl)
         return;
     }
 
+    // A newer load always supersedes a pending one.
+    cancelLoad();
+
+    const bool wasLoading = m_loading;
     m_loading = true;
-    m_document->setUndoRedoEnabled(false);
-    emit loadingChanged();
+    m_pendingFileUrl = fileUrl;
+
+    if (!wasLoading) {
+        emit loadingChanged();
+    }
 
     clearMatches();
 
-    QFile file(fileName);
-    if (file.open(QFile::ReadOnly)) {
-        QByteArray data = file.readAll();
-        QTextCodec *codec = QTextCodec::codecForName("UTF-8");
-        newDocument();
-        const auto text = codec->toUnicode(data);
-        const QString fileType = QFileInfo(file).suffix();
+    const QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_loadCancellation = cancelled;
 
-        if (fileType == persistence::format_markdown) {
-            MarkdownParser(m_document).parse(text);
-        } else {
-            m_document->setPlainText(text);
+    // The current document already carries the theme's defaults, so the new
+    // document can simply inherit them without touching the theme from the
+    // worker thread. The formats of the parsed blocks are copied for the
+    // same reason.
+    const QFont font = m_document->defaultFont();
+    const QTextOption textOption = m_document->defaultTextOption();
+    const MarkdownParser::BlockFormats blockFormats = MarkdownParser::BlockFormats::fromActiveTheme();
+    QThread* targetThread = thread();
+
+    QFutureWatcher<LoadResult>* watcher = new QFutureWatcher<LoadResult>(this);
+
+    connect(watcher, &QFutureWatcher<LoadResult>::finished, this, [this, watcher, cancelled, fileUrl, rules] {
+        const LoadResult result = watcher->result();
+        QTextDocument* document = result.document;
+        watcher->deleteLater();
+
+        if (cancelled->loadRelaxed() != 0) {
+            // Superseded by another load or a reset while the worker was
+            // still running.
+            delete document;
+
+            return;
         }
 
-        m_document->setModified(false);
-        connectDocument();
-        emit loaded();
+        if (!document) {
+            m_loadCancellation.reset();
+            m_pendingFileUrl = QUrl();
+            m_loading = false;
+            emit loadingChanged();
+            emit ErrorManager::instance()->error(tr("Cannot open: ") + QQmlFile::urlToLocalFileOrQrc(fileUrl));
 
-        setFileUrl(fileUrl);
-        emit lastModifiedChanged();
+            return;
+        }
+
+        finishLoad(document, fileUrl, rules, result.pendingChunks);
+    });
+
+    watcher->setFuture(QtConcurrent::run([=]() -> LoadResult {
+        return readDocument(fileName, font, textOption, blockFormats, targetThread, cancelled.data());
+    }));
+}
+
+void FormattableTextArea::finishLoad(QTextDocument* document, const QUrl& fileUrl, const WordCountRules rules, const QVector<PendingChunk>& pendingChunks)
+{
+    m_loadCancellation.reset();
+    m_pendingFileUrl = QUrl();
+
+    if (m_document) {
+        m_document->disconnect(this);
     }
 
+    discardPendingChunks();
+
+    document->setParent(this);
+    document->setTextWidth(this->width());
+    m_document = document;
+    m_textCursor = QTextCursor(m_document);
+
+    // Set without going through setWordCountRules() so that the new
+    // document is only counted once, when it is connected.
+    if (rules != wordCountRules()) {
+        m_wordCountRules = static_cast<wordcount::Rules>(rules);
+        emit wordCountRulesChanged();
+    }
+
+    // Must be reset before connecting the document, otherwise the initial
+    // word count would be suppressed.
     m_loading = false;
-    m_document->setUndoRedoEnabled(true);
+    connectDocument();
+
+    if (!pendingChunks.isEmpty()) {
+        m_pendingChunks = pendingChunks;
+
+        for (const PendingChunk& chunk : pendingChunks) {
+            m_pendingWordCount += chunk.wordCount;
+        }
+
+        updateWordCount();
+        countPendingChunks();
+        m_materializationTimer.start();
+    }
+
+    emit loaded();
+
+    setFileUrl(fileUrl);
+    emit lastModifiedChanged();
     emit loadingChanged();
 }
 
+void FormattableTextArea::cancelLoad()
+{
+    if (m_loadCancellation) {
+        m_loadCancellation->storeRelaxed(1);
+        m_loadCancellation.reset();
+    }
+
+    m_pendingFileUrl = QUrl();
+}
+
 void FormattableTextArea::saveAs(const QUrl &fileUrl, bool keepBackup)
 {
     if (!m_document)
         return;
 
     const QString filePath = QQmlFile::urlToLocalFileOrQrc(fileUrl);
-    const QFileInfo fileInfo = QFileInfo(filePath);
-    const QString fileType = fileInfo.suffix();
+    const QString fileType = QFileInfo(filePath).suffix();
 
-    QFile file(filePath);
+    if (fileType != persistence::format_markdown) {
+        // Pending chunks are only written as-is to markdown files.
+        materializeAll();
+    }
 
-    bool success = persistence::overwrite(file, static_cast<std::function<bool(QTextStream&)>>([&](QTextStream& stream)
-    {
-        if (fileType == persistence::format_markdown) {
-            MarkdownParser(m_document).write(stream);
-        } else if (fileType.contains(persistence::format_html)) {
-            stream << m_document->toHtml().toUtf8();
-        } else {
-            stream << m_document->toPlainText().toUtf8();
+    const QPointer<QTextDocument> document = m_document;
+    const int revision = m_document->revision();
+
+    m_writeQueue->enqueue(filePath, serialize(fileType), keepBackup, [this, document, revision, fileUrl](WriteQueue::Result result, const QString& errorString) {
+        if (result == WriteQueue::Failed) {
+            emit ErrorManager::instance()->error(tr("Cannot save: ") + errorString);
+            return;
         }
 
-        return true;
-    }), keepBackup);
+        if (result == WriteQueue::Superseded) {
+            // A newer save to the same file takes care of the state.
+            return;
+        }
 
-    if (!success) {
-        emit ErrorManager::instance()->error(tr("Cannot save: ") + file.errorString());
-    } else {
-        this->setModified(false);
+        // If the document was edited (or replaced) after the snapshot was
+        // taken, it still contains unsaved changes.
+        if (document == m_document && m_document->revision() == revision) {
+            this->setModified(false);
+        }
 
         emit lastModifiedChanged();
 
         if (fileUrl != m_fileUrl)
             setFileUrl(fileUrl);
-    }
+    });
 }
 
 void FormattableTextArea::backup()
@@ -277,23 +710,41 @@ void FormattableTextArea::backup()
 
     const QFileInfo fileInfo = QFileInfo(QQmlFile::urlToLocalFileOrQrc(m_fileUrl));
     const QString fileType = fileInfo.suffix();
-    QFile backupFile(QStringLiteral("%1.%2").arg(QQmlFile::urlToLocalFileOrQrc(m_fileUrl)).arg(persistence::format_bak));
 
-    bool success = persistence::overwrite(backupFile, static_cast<std::function<bool(QTextStream&)>>([&](QTextStream& stream)
-    {
-        if (fileType == persistence::format_markdown) {
-            MarkdownParser(m_document).write(stream);
-        } else if (fileType.contains(persistence::format_html)) {
-            stream << m_document->toHtml().toUtf8();
-        } else {
-            stream << m_document->toPlainText().toUtf8();
+    if (fileType != persistence::format_markdown) {
+        materializeAll();
+    }
+
+    const QString backupPath = QStringLiteral("%1.%2").arg(QQmlFile::urlToLocalFileOrQrc(m_fileUrl)).arg(persistence::format_bak);
+
+    m_writeQueue->enqueue(backupPath, serialize(fileType), false, [](WriteQueue::Result result, const QString& errorString) {
+        if (result == WriteQueue::Failed) {
+            emit ErrorManager::instance()->error(tr("Cannot backup: ") + errorString);
         }
+    });
+}
 
-        return true;
-    }), false);
+void FormattableTextArea::waitForWrites()
+{
+    m_writeQueue->waitForDone();
+}
+
+QStringList FormattableTextArea::serialize(const QString& fileType) const
+{
+    if (fileType == persistence::format_markdown) {
+        QStringList blocks = MarkdownParser(m_document).serializeBlocks();
+
+        // Every serialized block ends with a blank line, so the markdown of
+        // chunks that were not parsed yet can be written just as it was read.
+        for (const PendingChunk& chunk : m_pendingChunks) {
+            blocks.append(QString::fromUtf8(chunk.markdown));
+        }
 
-    if (!success) {
-        emit ErrorManager::instance()->error(tr("Cannot backup: ") + backupFile.errorString());
+        return blocks;
+    } else if (fileType.contains(persistence::format_html)) {
+        return { m_document->toHtml() };
+    } else {
+        return { m_document->toPlainText() };
     }
 }
 
@@ -316,6 +767,13 @@ bool FormattableTextArea::rename(const QUrl& newName)
 
 void FormattableTextArea::reset()
 {
+    cancelLoad();
+
+    if (m_loading) {
+        m_loading = false;
+        emit loadingChanged();
+    }
+
     newDocument();
     connectDocument();
     m_characterCount = 0;
@@ -355,9 +813,12 @@ void FormattableTextArea::moveCursor(QTextCursor::MoveOperation op, QTextCursor:
 void FormattableTextArea::clearUndoStack()
 {
     m_document->clearUndoRedoStacks(QTextDocument::Stacks::UndoAndRedoStacks);
+    m_undoBarrier = 0;
+    emit canUndoChanged(canUndo());
 }
 
 void FormattableTextArea::mergeFormat(const QTextCharFormat &format)
 {
+    prepareForEdit();
     m_textCursor.mergeCharFormat(format);
 }
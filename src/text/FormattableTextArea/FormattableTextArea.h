@@ -10,6 +10,9 @@
 #include <QTextLayout>
 #include <QTextDocument>
 #include <QTimer>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QSet>
 
 #include "../TextFormatter.h"
 #include "../TextHighlighter.h"
@@ -17,7 +20,13 @@
 #include "../MarkdownParser.h"
 #include "../StringReplacer.h"
 #include "../DocumentSegment.h"
+#include "../DocumentStructureModel.h"
+#include "../wordcount.h"
+#include "../outline.h"
+#include "../WordCountIndex.h"
+#include "../PrefixSums.h"
 #include "../../Range.h"
+#include "../../WriteQueue.h"
 
 QT_BEGIN_NAMESPACE
 class QTextDocument;
@@ -44,6 +53,8 @@ class FormattableTextArea : public QQuickItem
 
     Q_PROPERTY(QTextDocument* document READ document NOTIFY documentChanged)
     Q_PROPERTY(const QVector<DocumentSegment*>& documentStructure READ documentStructure NOTIFY documentStructureChanged)
+    //! The document structure as a list model, which is updated row by row.
+    Q_PROPERTY(DocumentStructureModel* documentStructureModel READ documentStructureModel CONSTANT)
     Q_PROPERTY(DocumentSegment* currentDocumentSegment READ currentDocumentSegment NOTIFY currentDocumentSegmentChanged)
 
     Q_PROPERTY(bool canUndo READ canUndo NOTIFY canUndoChanged)
@@ -58,6 +69,13 @@ class FormattableTextArea : public QQuickItem
     Q_PROPERTY(int characterCount READ characterCount NOTIFY characterCountChanged)
     Q_PROPERTY(int paragraphCount READ paragraphCount NOTIFY paragraphCountChanged)
     Q_PROPERTY(int wordCount READ wordCount NOTIFY wordCountChanged)
+    //! True while the words of a newly connected document are being counted
+    //! in the background. wordCount is not updated until the count is done.
+    Q_PROPERTY(bool countingWords READ countingWords NOTIFY countingWordsChanged)
+    //! The rules that determine what counts as a word in this document.
+    //! Changing them recounts all words. load() replaces them with the rules
+    //! chosen for the loaded file.
+    Q_PROPERTY(WordCountRules wordCountRules READ wordCountRules WRITE setWordCountRules NOTIFY wordCountRulesChanged)
     Q_PROPERTY(int pageCount READ pageCount NOTIFY pageCountChanged)
 
     Q_PROPERTY(int selectedCharacterCount READ selectedCharacterCount NOTIFY selectedCharacterCountChanged)
@@ -70,6 +88,9 @@ class FormattableTextArea : public QQuickItem
     Q_PROPERTY(double overflowArea READ overflowArea WRITE setOverflowArea NOTIFY overflowAreaChanged)
 
     Q_PROPERTY(int searchResultCount READ searchResultCount NOTIFY searchResultCountChanged)
+    //! True while a large document is being searched in the background.
+    //! searchResultCount grows as matches are found until the search is done.
+    Q_PROPERTY(bool searching READ searching NOTIFY searchingChanged)
 
     //! If true, emphasized text segments (enclosed in asterisks or underscores)
     //! will be underlined rather than italicized.
@@ -77,6 +98,7 @@ class FormattableTextArea : public QQuickItem
 
     public:
         explicit FormattableTextArea(QQuickItem *parent = nullptr);
+        ~FormattableTextArea() override;
 
         enum class SelectionMode {
             NoSelection,
@@ -95,6 +117,24 @@ class FormattableTextArea : public QQuickItem
         Q_DECLARE_FLAGS(SearchOptions, SearchOption)
         Q_FLAG(SearchOptions)
 
+        //! Exposes wordcount::Rules to QML.
+        enum class WordCountRules {
+            Standard = int(wordcount::Rules::Standard),
+            Ideographic = int(wordcount::Rules::Ideographic),
+            SplitCompounds = int(wordcount::Rules::SplitCompounds),
+            SplitApostrophes = int(wordcount::Rules::SplitApostrophes)
+        };
+        Q_ENUM(WordCountRules)
+
+        //! A range of markdown that was split off a large file during
+        //! loading and has not been parsed into the document yet.
+        struct PendingChunk {
+            QByteArray markdown;
+            //! The number of words in the chunk. Estimated from the raw
+            //! markdown until countPendingChunks() has counted it exactly.
+            int wordCount;
+        };
+
         QSGNode* updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *updatePaintNodeData) override;
         bool event(QEvent* event) override;
         void keyPressEvent(QKeyEvent* event) override;
@@ -104,8 +144,24 @@ class FormattableTextArea : public QQuickItem
 
         QTextDocument* document() const;
         const QVector<DocumentSegment*>& documentStructure() const;
+        DocumentStructureModel* documentStructureModel() const;
         DocumentSegment* currentDocumentSegment() const;
         DocumentSegment* findDocumentSegment(int position) const;
+        //! Gets the DocumentSegment the block belongs to. Blocks are tagged
+        //! with their segment whenever the document structure changes, so
+        //! this usually takes constant time.
+        DocumentSegment* findDocumentSegment(const QTextBlock& block) const;
+        //! Gets the prefix sums over the word counts of all blocks.
+        const WordCountIndex& wordCountIndex() const;
+        //! Gets the position of the segment at the given index in the
+        //! document structure.
+        int segmentPosition(int index) const;
+        //! Gets the length of the segment at the given index in the document
+        //! structure.
+        int segmentLength(int index) const;
+        //! Determines whether the segment is told when its position changes.
+        //! Only segments something is connected to need to be.
+        void observeSegment(DocumentSegment* segment, bool observe);
 
         double contentY() const;
         void setContentY(double contentY);
@@ -128,11 +184,15 @@ class FormattableTextArea : public QQuickItem
 
         const QVector<Range<int>>& searchResults() const;
         int searchResultCount() const;
+        bool searching() const;
 
         int characterCount() const;
         int paragraphCount() const;
         int wordCount() const;
         int pageCount() const;
+        bool countingWords() const;
+        WordCountRules wordCountRules() const;
+        void setWordCountRules(WordCountRules rules);
 
         int selectedCharacterCount() const;
         int selectedParagraphCount() const;
@@ -161,10 +221,23 @@ class FormattableTextArea : public QQuickItem
         //! Resets the text area by detaching the document and clearing the
         //! loaded file.
         void reset();
-        void load(const QUrl &fileUrl);
+        //! Loads the specified file. Reading and parsing happen on a worker
+        //! thread into a detached document which is swapped in once it is
+        //! complete, so loading is true until loaded() is emitted.
+        //! Loading another file (or resetting) cancels a pending load.
+        //! The document is counted with the specified rules, which replace
+        //! wordCountRules once it is swapped in.
+        void load(const QUrl &fileUrl, WordCountRules rules = WordCountRules::Standard);
+        //! Saves the document to the specified file. The document is
+        //! snapshotted immediately, but written to disk on a background
+        //! thread. modified and lastModified update once the write has been
+        //! committed.
         void saveAs(const QUrl &fileUrl, bool keepBackup = true);
-        //! Backs up the current file.
+        //! Backs up the current file. Like saveAs(), the backup is written
+        //! on a background thread.
         void backup();
+        //! Blocks until all pending saves and backups have been committed.
+        void waitForWrites();
         bool rename(const QUrl& newName);
 
         //! Copies the selected text.
@@ -236,10 +309,13 @@ class FormattableTextArea : public QQuickItem
         void loadingChanged();
 
         void searchResultCountChanged();
+        void searchingChanged();
 
         void characterCountChanged();
         void paragraphCountChanged();
         void wordCountChanged();
+        void countingWordsChanged();
+        void wordCountRulesChanged();
         void pageCountChanged();
 
         void selectedCharacterCountChanged();
@@ -266,18 +342,79 @@ class FormattableTextArea : public QQuickItem
 
         QTextDocument* newDocument();
         void connectDocument();
+        //! Swaps in a document that was constructed by load(). Chunks that
+        //! were not parsed yet are appended to the document in the
+        //! background.
+        void finishLoad(QTextDocument* document, const QUrl& fileUrl, WordCountRules rules, const QVector<PendingChunk>& pendingChunks);
+        //! Aborts the currently running load, if any.
+        void cancelLoad();
+        //! Takes a snapshot of the document serialized in the specified
+        //! format, split into chunks that are written in order.
+        QStringList serialize(const QString& fileType) const;
+
+        //! Parses the next pending chunk and appends it to the document.
+        void materializeNext();
+        //! Parses all pending chunks. Must be called before any operation
+        //! that needs to see the entire document.
+        void materializeAll();
+        //! Parses pending chunks until the document contains the position.
+        void ensureMaterialized(int position);
+        //! Must be called before every edit the user makes. Stops appending
+        //! pending chunks in the background, since each append becomes an
+        //! undo barrier once the user edited the document. From then on,
+        //! chunks are only appended when the caret or the viewport reach
+        //! the end of the parsed text.
+        void prepareForEdit();
+        void discardPendingChunks();
+        //! Parses copies of all pending chunks on worker threads to replace
+        //! their estimated word counts with exact ones.
+        void countPendingChunks();
+        //! Emits the word count without it being mistaken for words the user
+        //! has written (see countingWords()).
+        void applyUntrackedWordCount();
         QTextDocument* m_document;
         QVector<DocumentSegment*> m_documentStructure;
+        DocumentStructureModel* m_documentStructureModel;
+        //! The length of each segment in m_documentStructure, from which
+        //! their positions are derived.
+        PrefixSums m_segmentLengths;
+        //! All segments something is connected to the positionChanged()
+        //! signal of.
+        QSet<DocumentSegment*> m_observedSegments;
+        //! The index of the first segment whose position changed since the
+        //! last call of processChanges(), or -1 if no position changed.
+        int m_segmentPositionsChangedFrom;
+        WordCountIndex m_wordCountIndex;
         DocumentSegment* m_currentDocumentSegment;
         TextFormatter* m_formatter;
         TextHighlighter* m_highlighter;
         StringReplacer m_replacer;
+        WriteQueue* m_writeQueue;
 
         QTextCursor m_textCursor;
         double m_contentY;
         double m_overflowArea;
 
         QUrl m_fileUrl;
+        QUrl m_pendingFileUrl;
+        QSharedPointer<QAtomicInt> m_loadCancellation;
+        QVector<PendingChunk> m_pendingChunks;
+        //! The number of words in all pending chunks.
+        int m_pendingWordCount;
+        //! The number of chunks appended since the document was loaded.
+        int m_materializedChunkCount;
+        QSharedPointer<QAtomicInt> m_pendingCountCancellation;
+        QTimer m_materializationTimer;
+        //! The number of undo steps that can't be undone because a pending
+        //! chunk was appended after them.
+        int m_undoBarrier;
+        //! The range of text changed since the last call of processChanges(),
+        //! or an invalid range if there were no changes.
+        Range<int> m_dirtyRange;
+        //! How far the text following the dirty range moved since the
+        //! search results were last updated.
+        int m_searchResultsOffset;
+        QTimer m_changeTimer;
         bool m_loading;
         bool m_isUndoRedo;
 
@@ -285,6 +422,12 @@ class FormattableTextArea : public QQuickItem
         void setFileUrl(const QUrl& url);
 
         void handleTextChange(const int position, const int added, const int removed);
+        //! Adds the changed text to the dirty range and schedules
+        //! processChanges() if it isn't already scheduled.
+        void scheduleChange(const int position, const int removed, const int added);
+        //! Recounts the words in the dirty range and updates all statistics
+        //! and find results that depend on it.
+        void processChanges();
         //! Calls update() and sets appropriate variables that indicate the
         //! user is actively editing the document instead of just being idle.
         //! This includes ensuring the caret blinking timer is reset.
@@ -293,12 +436,68 @@ class FormattableTextArea : public QQuickItem
 
         void updateDocumentStructure(const int position, const int added, const int removed);
         void countWords(const int position, const int change);
-        void updateFindRanges();
+        //! Keeps the word count index in step with the blocks of the
+        //! document when a change at the given position inserted or removed
+        //! blocks, without rebuilding it.
+        void shiftWordCountIndex(const int position);
+        //! Counts the words of all blocks. Large documents are counted on
+        //! worker threads over a snapshot of the text, and the counts are
+        //! written back once all workers are done.
+        void countAllWords();
+        void finishCountingWords();
+        //! Sums up the word counts of all blocks and emits the result.
+        void applyWordCount();
+        //! Searches for all occurrences of the current search string that
+        //! lie between the given positions.
+        QVector<Range<int>> findMatches(const int from, const int until) const;
+        //! Gets the range of text the current search is limited to.
+        Range<int> searchBounds() const;
+        //! Searches the given range on worker threads over a copy of the
+        //! text. Matches are added to the search results in batches, starting
+        //! with the blocks that are currently visible.
+        void findInBackground(const int from, const int until);
+        //! Moves matches found in the copy of the text to where they are now.
+        //! Matches in blocks edited since then are dropped since
+        //! updateFindRanges() searches those blocks again.
+        QVector<Range<int>> mapSearchResults(const QVector<Range<int>>& matches) const;
+        //! Merges the given matches into the search results.
+        void addSearchResults(QVector<Range<int>> matches);
+        //! Stops the background search, if any. Matches that were already
+        //! found are kept.
+        void cancelSearch();
+        //! Replaces a running background search with a synchronous one so
+        //! that all matches are known when this function returns.
+        void completeSearch();
+        void finishSearching();
+        //! Searches the blocks in the changed range again and shifts all
+        //! search results following it by the given offset.
+        void updateFindRanges(const Range<int>& changedRange, const int offset);
         void refreshDocumentStructure();
+        //! Brings the document structure up to date after the blocks between
+        //! from and until changed. Only the headings around these blocks are
+        //! looked at, and only the segments that changed are replaced. All
+        //! other segments are kept, along with their word counts.
+        void spliceDocumentStructure(const int from, const int until);
+        //! Sets the segment lengths from the positions of the outline entries.
+        void resetSegmentLengths(const QVector<outline::Entry>& entries);
+        //! Tags all blocks from the start of the segment until its end with
+        //! the segment (see findDocumentSegment()).
+        void tagBlocks(DocumentSegment* segment);
 
         int m_characterCount;
         int m_selectedCharacterCount;
         int m_wordCount;
+        bool m_countingWords;
+        wordcount::Rules m_wordCountRules;
+        //! Incremented whenever a background count is started so that the
+        //! results of outdated counts can be recognized.
+        int m_wordCountGeneration;
+        //! The range of text edited while the background count was running,
+        //! or an invalid range if there were no edits.
+        Range<int> m_wordCountDirtyRange;
+        //! How far the text following m_wordCountDirtyRange moved since the
+        //! background count took its snapshot.
+        int m_wordCountOffset;
         int m_selectedWordCount;
         int m_paragraphCount;
         int m_selectedParagraphCount;
@@ -316,6 +515,16 @@ class FormattableTextArea : public QQuickItem
 
         QString m_searchString;
         SearchOptions m_searchFlags;
+        bool m_searching;
+        //! The number of search results before the running search started.
+        int m_searchResultCountBeforeSearch;
+        QSharedPointer<QAtomicInt> m_searchCancellation;
+        //! The blocks edited since the running search took its copy of the
+        //! text, or an invalid range if there were no edits.
+        Range<int> m_searchEditedRange;
+        //! How far the text following the edited blocks moved since the
+        //! running search took its copy of the text.
+        int m_searchEditOffset;
 
         bool m_underline;
 
@@ -324,7 +533,6 @@ class FormattableTextArea : public QQuickItem
 
         QMouseEvent m_lastMouseUpEvent;
         QMouseEvent m_lastMouseDownEvent;
-        int m_lastCaretPosition;
         SelectionMode m_selectionMode;
 };
 
@@ -41,6 +41,8 @@ void FormattableTextArea::applyHeading(int level)
         return;
     }
 
+    prepareForEdit();
+
     if (level == 0) {
         const Theme* theme = ThemeManager::instance()->activeTheme();
         m_textCursor.setBlockFormat(theme->blockFormat());
@@ -49,13 +51,14 @@ void FormattableTextArea::applyHeading(int level)
         m_textCursor.setBlockFormat(format.blockFormat());
     }
 
-    refreshDocumentStructure();
+    spliceDocumentStructure(m_textCursor.selectionStart(), m_textCursor.selectionEnd());
 
     updateActive();
 }
 
 void FormattableTextArea::insertSceneBreak()
 {
+    prepareForEdit();
     m_textCursor.beginEditBlock();
 
     format::insertSceneBreak(m_textCursor);
@@ -86,6 +89,8 @@ void FormattableTextArea::paste()
         return;
     }
 
+    prepareForEdit();
+
     bool hadSelection = m_textCursor.hasSelection();
     QString insertedString;
     const QMimeData* mimeData = QGuiApplication::clipboard()->mimeData();
@@ -133,6 +138,8 @@ void FormattableTextArea::pasteUnformatted()
         return;
     }
 
+    prepareForEdit();
+
     bool hadSelection = m_textCursor.hasSelection();
     QString insertedString;
     const QMimeData* mimeData = QGuiApplication::clipboard()->mimeData();
@@ -161,6 +168,8 @@ void FormattableTextArea::pasteUnformatted()
 void FormattableTextArea::remove()
 {
     if (m_textCursor.hasSelection()) {
+        prepareForEdit();
+
         int position = m_textCursor.selectionStart();
         QString text = m_textCursor.selectedText();
 
@@ -188,10 +197,16 @@ void FormattableTextArea::cut()
 
 void FormattableTextArea::undo()
 {
+    if (!canUndo()) {
+        // Undoing past the barrier would remove appended chunks.
+        return;
+    }
+
     bool hadSelection = m_textCursor.hasSelection();
     m_isUndoRedo = true;
     m_document->undo(&m_textCursor);
     m_isUndoRedo = false;
+    emit canUndoChanged(canUndo());
     updateActive();
     emit caretPositionChanged();
 
@@ -210,6 +225,7 @@ void FormattableTextArea::redo()
     m_isUndoRedo = true;
     m_document->redo(&m_textCursor);
     m_isUndoRedo = false;
+    emit canUndoChanged(canUndo());
     updateActive();
     emit caretPositionChanged();
 
@@ -238,6 +254,7 @@ void FormattableTextArea::selectParagraph()
 
 void FormattableTextArea::selectAll()
 {
+    materializeAll();
     m_textCursor.select(QTextCursor::SelectionType::Document);
     emit caretPositionChanged();
     emit selectedTextChanged();
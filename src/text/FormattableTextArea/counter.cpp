@@ -8,13 +8,91 @@
 #include <QTextDocument>
 #include <QQuickTextDocument>
 #include <QtConcurrent/QtConcurrent>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QSharedPointer>
 
 #include "FormattableTextArea.h"
 #include "../TextIterator.h"
 #include "../UserData.h"
 #include "../symbols.h"
+#include "../wordcount.h"
 #include "../../profiling.h"
 
+namespace {
+    //! Documents with fewer characters than this are counted synchronously,
+    //! since starting the workers would take longer than counting.
+    constexpr int BACKGROUND_COUNT_THRESHOLD = 64 * 1024;
+    //! The number of blocks a single worker counts at once.
+    constexpr int BLOCKS_PER_TASK = 512;
+
+    struct WordCountTask {
+        int from;
+        int until;
+        QVector<int> counts;
+    };
+
+    //! A read-only copy of everything the workers need from the document.
+    struct WordCountSnapshot {
+        //! The text of the entire document as returned by toRawText().
+        QString text;
+        QVector<int> positions;
+        QVector<int> lengths;
+        QVector<QVector<Range<int>>> comments;
+        wordcount::Rules rules;
+        QVector<WordCountTask> tasks;
+
+        int count(int block) const
+        {
+            return tasks.at(block / BLOCKS_PER_TASK).counts.at(block % BLOCKS_PER_TASK);
+        }
+    };
+
+    //! Writes the counts of the snapshot into the blocks of the document.
+    //! Text edited since the snapshot was taken lies within dirtyRange, and
+    //! the text after it moved by offset. All other blocks still have the
+    //! text they had in the snapshot, so only the edited blocks are counted
+    //! again.
+    void applyCounts(QTextDocument* document, const WordCountSnapshot& snapshot, const Range<int>& dirtyRange, const int offset)
+    {
+        const int blockCount = snapshot.positions.size();
+        const int snapshotEnd = snapshot.positions.last() + snapshot.lengths.last() + 1;
+        int index = 0;
+
+        for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+            const int position = block.position();
+            int snapshotPosition = position;
+
+            if (dirtyRange.isValid() && position + block.length() > dirtyRange.from()) {
+                if (position < dirtyRange.until()) {
+                    UserData::fromBlock(block).setWordCount(wordcount::count(block, snapshot.rules));
+                    continue;
+                }
+
+                snapshotPosition = position - offset;
+            }
+
+            if (snapshotPosition >= snapshotEnd) {
+                // The remaining blocks were appended in the meantime (see
+                // materializeNext()) and counted when they were added.
+                break;
+            }
+
+            while (index < blockCount && snapshot.positions.at(index) < snapshotPosition) {
+                index++;
+            }
+
+            if (index < blockCount && snapshot.positions.at(index) == snapshotPosition) {
+                UserData::fromBlock(block).setWordCount(snapshot.count(index));
+            } else {
+                // The block starts right after the edited text, where the
+                // snapshot had no block boundary.
+                UserData::fromBlock(block).setWordCount(wordcount::count(block, snapshot.rules));
+            }
+        }
+    }
+}
+
 int FormattableTextArea::characterCount() const
 {
     return this->m_characterCount;
@@ -25,6 +103,38 @@ int FormattableTextArea::wordCount() const
     return this->m_wordCount;
 }
 
+bool FormattableTextArea::countingWords() const
+{
+    return m_countingWords;
+}
+
+FormattableTextArea::WordCountRules FormattableTextArea::wordCountRules() const
+{
+    return static_cast<WordCountRules>(m_wordCountRules);
+}
+
+void FormattableTextArea::setWordCountRules(WordCountRules rules)
+{
+    if (rules == wordCountRules()) {
+        return;
+    }
+
+    m_wordCountRules = static_cast<wordcount::Rules>(rules);
+    emit wordCountRulesChanged();
+
+    if (!m_document) {
+        return;
+    }
+
+    // The difference to the previous count is not something the user wrote,
+    // which is why the recount is marked like the initial one.
+    m_countingWords = true;
+    emit countingWordsChanged();
+
+    countAllWords();
+    countPendingChunks();
+}
+
 int FormattableTextArea::paragraphCount() const
 {
     return this->m_paragraphCount;
@@ -87,37 +197,162 @@ void FormattableTextArea::countWords(const int position, const int change)
     int end = position + change;
 
     while (block.isValid() && block.position() < end) {
-        QTextCursor cursor = QTextCursor(block);
-        cursor.select(QTextCursor::SelectionType::BlockUnderCursor);
-        TextIterator textIterator = this->wordIterator(cursor);
-        int i = 0;
-
-        while (!textIterator.atEnd()) {
-            if (!textIterator.current().isEmpty()) {
-                i++;
-            }
+        const int words = wordcount::count(block, m_wordCountRules);
+        UserData::fromBlock(block).setWordCount(words);
+        m_wordCountIndex.setWordCount(block.blockNumber(), words);
 
-            textIterator++;
-        };
+        block = block.next();
+    }
+}
 
-        UserData::fromBlock(block).setWordCount(i);
+void FormattableTextArea::shiftWordCountIndex(const int position)
+{
+    // Blocks are only ever inserted or removed after the block that
+    // contains the position of the change, so the blocks before it keep
+    // their numbers and the blocks after it keep their word counts. The
+    // entries in-between are overwritten once the changed blocks are
+    // counted again.
+    const int addedBlocks = m_document->blockCount() - m_wordCountIndex.size();
+    const int blockNumber = m_document->findBlock(position).blockNumber();
+
+    if (addedBlocks > 0) {
+        m_wordCountIndex.insertBlocks(blockNumber, addedBlocks);
+    } else if (addedBlocks < 0) {
+        m_wordCountIndex.removeBlocks(blockNumber, -addedBlocks);
+    }
+}
 
-        block = block.next();
+void FormattableTextArea::countAllWords()
+{
+    const int generation = ++m_wordCountGeneration;
+    m_wordCountDirtyRange = Range<int>();
+    m_wordCountOffset = 0;
+
+    if (m_document->characterCount() < BACKGROUND_COUNT_THRESHOLD) {
+        countWords(0, m_document->characterCount());
+
+        if (m_countingWords) {
+            finishCountingWords();
+        }
+
+        return;
+    }
+
+    // Positions in the raw text are the same as positions in the document,
+    // so a single copy of the text is enough to count every block.
+    // Keeps the index in step with the blocks while they are being counted,
+    // so that edits made in the meantime can update it.
+    m_wordCountIndex.reset(m_document);
+
+    const QSharedPointer<WordCountSnapshot> snapshot(new WordCountSnapshot());
+    snapshot->text = m_document->toRawText();
+    snapshot->rules = m_wordCountRules;
+
+    for (QTextBlock block = m_document->begin(); block.isValid(); block = block.next()) {
+        const UserData* userData = dynamic_cast<const UserData*>(block.userData());
+
+        snapshot->positions.append(block.position());
+        snapshot->lengths.append(block.length() - 1);
+        snapshot->comments.append(userData ? userData->comments() : QVector<Range<int>>());
+    }
+
+    const int blockCount = snapshot->positions.size();
+
+    for (int i = 0; i < blockCount; i += BLOCKS_PER_TASK) {
+        snapshot->tasks.append({ i, qMin(i + BLOCKS_PER_TASK, blockCount), {} });
+    }
+
+    if (!m_countingWords) {
+        m_countingWords = true;
+        emit countingWordsChanged();
     }
+
+    QFutureWatcher<void>* watcher = new QFutureWatcher<void>(this);
+    const QPointer<QTextDocument> document = m_document;
+
+    connect(watcher, &QFutureWatcher<void>::finished, this, [this, watcher, snapshot, generation, document] {
+        watcher->deleteLater();
+
+        if (generation != m_wordCountGeneration || document != m_document) {
+            // Superseded by a newer count.
+            return;
+        }
+
+        // Edits made in the meantime only invalidate the counts of the
+        // blocks they touched, so the count never has to start over.
+        applyCounts(m_document, *snapshot, m_wordCountDirtyRange, m_wordCountOffset);
+        m_wordCountDirtyRange = Range<int>();
+        m_wordCountOffset = 0;
+
+        m_wordCountIndex.reset(m_document);
+        finishCountingWords();
+    });
+
+    // The functor holds on to the snapshot so that it outlives the workers
+    // even if the text area is destroyed in the meantime.
+    watcher->setFuture(QtConcurrent::map(snapshot->tasks, [snapshot](WordCountTask& task) {
+        task.counts.reserve(task.until - task.from);
+
+        for (int i = task.from; i < task.until; i++) {
+            const QChar* text = snapshot->text.constData() + snapshot->positions.at(i);
+            task.counts.append(wordcount::count(text, snapshot->lengths.at(i), snapshot->comments.at(i), snapshot->rules));
+        }
+    }));
+}
+
+void FormattableTextArea::finishCountingWords()
+{
+    // Prevent each individual call of segment->updateWordCount()
+    // from calling FormattableTextArea::updateWordCount()
+    const bool wasLoading = m_loading;
+    m_loading = true;
+
+    for (DocumentSegment* segment : m_documentStructure) {
+        segment->updateWordCount();
+    }
+
+    m_loading = wasLoading;
+
+    // The new count is emitted while countingWords is still true, so that
+    // the difference to the previous document's count is not mistaken for
+    // words the user has written.
+    applyWordCount();
+
+    m_countingWords = false;
+    emit countingWordsChanged();
 }
 
 void FormattableTextArea::updateWordCount()
 {
-    if (m_loading) {
+    if (m_loading || m_countingWords) {
         return;
     }
 
-    int words = 0;
+    applyWordCount();
+}
 
-    for (const DocumentSegment* segment : m_documentStructure) {
-        words += segment->wordCount();
+void FormattableTextArea::applyUntrackedWordCount()
+{
+    if (m_countingWords) {
+        // finishCountingWords() applies the count once it's done.
+        return;
     }
 
+    m_countingWords = true;
+    emit countingWordsChanged();
+
+    applyWordCount();
+
+    m_countingWords = false;
+    emit countingWordsChanged();
+}
+
+void FormattableTextArea::applyWordCount()
+{
+    // Chunks of large files that were not parsed yet only contribute an
+    // estimate until countPendingChunks() is done.
+    const int words = m_pendingWordCount + m_wordCountIndex.total();
+
     if (words != this->m_wordCount) {
         m_wordCount = words;
         emit wordCountChanged();
@@ -132,23 +367,48 @@ void FormattableTextArea::updateSelectedWordCount()
         return;
     }
 
-    TextIterator textIterator = this->wordIterator(m_textCursor);
+    if (m_dirtyRange.isValid()) {
+        // The block counts and the index only catch up with edits in
+        // processChanges(), which counts the selection again once they did.
+        processChanges();
+
+        if (m_textCursor.hasSelection()) {
+            return;
+        }
+    }
+
+    const int selectionStart = m_textCursor.selectionStart();
+    const int selectionEnd = m_textCursor.selectionEnd();
+    const QTextBlock first = m_document->findBlock(selectionStart);
+    const QTextBlock last = m_document->findBlock(selectionEnd);
     int i = 0;
 
-    while (!textIterator.atEnd()) {
-        if (!textIterator.current().isEmpty()) {
-            i++;
+    if (first == last) {
+        i = wordcount::count(first, selectionStart - first.position(), selectionEnd - first.position(), m_wordCountRules);
+    } else {
+        // Words never span multiple blocks, so only the blocks at either end
+        // of the selection need to be counted. All blocks in-between are
+        // fully selected and already know their word count (except while
+        // countAllWords() is still running).
+        i += wordcount::count(first, selectionStart - first.position(), first.length(), m_wordCountRules);
+
+        if (m_countingWords) {
+            for (QTextBlock block = first.next(); block.isValid() && block != last; block = block.next()) {
+                i += wordcount::count(block, m_wordCountRules);
+            }
+        } else {
+            i += m_wordCountIndex.wordCount(first.blockNumber() + 1, last.blockNumber());
         }
 
-        textIterator++;
-    };
+        i += wordcount::count(last, 0, selectionEnd - last.position(), m_wordCountRules);
+    }
 
     if (i != this->m_selectedWordCount) {
         m_selectedWordCount = i;
         emit selectedWordCountChanged();
     }
 
-    const int selectedPages = m_selectedWordCount / 250 + (m_selectedWordCount % 250 != 0 ? 1 : 0);
+    const int selectedPages = wordcount::pageCount(m_selectedWordCount);
     if (m_selectedPageCount != selectedPages) {
         m_selectedPageCount = selectedPages;
         emit selectedPageCountChanged();
@@ -186,7 +446,7 @@ void FormattableTextArea::updatePageCount()
     }
 
     const int wordCount = this->wordCount();
-    const int pageCount = wordCount / 250 + (wordCount % 250 != 0 ? 1 : 0);
+    const int pageCount = wordcount::pageCount(wordCount);
 
     if (pageCount != this->m_pageCount) {
         this->m_pageCount = pageCount;
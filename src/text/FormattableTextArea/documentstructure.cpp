@@ -7,153 +7,253 @@
 
 #include "FormattableTextArea.h"
 #include "../symbols.h"
+#include "../outline.h"
+#include "../UserData.h"
 
 void FormattableTextArea::updateDocumentStructure(const int position, const int added, const int removed)
 {
-    const int change = added - removed;
-
-    if (m_documentStructure.isEmpty()) {
+    if (m_documentStructure.isEmpty() || added == removed) {
         return;
     }
 
-    if (change > 0) {
-        // Text was inserted.
+    // Only the lengths of the segments that contain the change are updated.
+    // The positions of all following segments are derived from them.
+    const int first = m_segmentLengths.indexOf(position);
+    bool boundaryRemoved = false;
 
-        DocumentSegment* targetSegment = nullptr;
+    if (removed > 0) {
+        const int last = m_segmentLengths.indexOf(position + removed);
 
-        for (DocumentSegment* segment : m_documentStructure) {
-            if (targetSegment) {
-                segment->setPosition(segment->position() + change);
-                continue;
-            }
+        if (first == last) {
+            m_segmentLengths.add(first, -removed);
+        } else {
+            // Text was removed from more than one DocumentSegment.
+            // This means that a DocumentSegment boundary was removed,
+            // i.e. the number of DocumentSegments is not the same
+            // as before.
+            const int firstEnd = m_segmentLengths.sumBefore(first + 1);
+            const int lastStart = m_segmentLengths.sumBefore(last);
 
-            const DocumentSegment* next = segment->next();
+            m_segmentLengths.add(first, position - firstEnd);
 
-            if (next == nullptr || (position >= segment->position() && position < next->position())) {
-                targetSegment = segment;
+            for (int i = first + 1; i < last; i++) {
+                m_segmentLengths.setValue(i, 0);
             }
-        }
 
-        if (targetSegment) {
-            emit targetSegment->textChanged();
-            targetSegment->updateWordCount();
+            m_segmentLengths.add(last, lastStart - position - removed);
+            boundaryRemoved = true;
         }
-    } else if (change < 0) {
-        // Text was removed.
-
-        int textEnd = position - change;
-        int length = m_documentStructure.count();
-        int startSegment = -1;
-        int endSegment = -1;
+    }
 
-        for (int i = 0; i < length; i++) {
-            DocumentSegment* segment = m_documentStructure.at(i);
-            const int segmentStart = segment->position();
-            const int segmentEnd = i < length - 1 ? m_documentStructure.at(i + 1)->position() : m_document->characterCount() - change;
+    m_segmentLengths.add(first, added);
 
-            if (segmentStart <= position && position < segmentEnd && startSegment == -1) {
-                startSegment = i;
-            }
+    if (m_segmentPositionsChangedFrom < 0 || first + 1 < m_segmentPositionsChangedFrom) {
+        m_segmentPositionsChangedFrom = first + 1;
+    }
 
-            if (startSegment != -1 && segmentStart <= textEnd && textEnd < segmentEnd) {
-                endSegment = i;
-            }
+    if (boundaryRemoved) {
+        spliceDocumentStructure(position, position + added);
+        return;
+    }
 
-            if (startSegment < i) {
-                segment->setPosition(segment->position() + change);
+    if (added > 0) {
+        // Inserted text may contain new headings (e.g. when undoing their
+        // removal or pasting), which only needs to be checked for if any
+        // blocks were inserted.
+        const QTextBlock firstBlock = m_document->findBlock(position);
+        const QTextBlock lastBlock = m_document->findBlock(position + added);
+
+        for (QTextBlock block = firstBlock; firstBlock != lastBlock && block.isValid() && block.position() <= lastBlock.position(); block = block.next()) {
+            if (block.blockFormat().headingLevel() > 0) {
+                spliceDocumentStructure(position, position + added);
+                return;
             }
         }
 
-        if (startSegment != endSegment) {
-            // Text was removed from more than one DocumentSegment.
-            // This means that a DocumentSegment boundary was removed,
-            // i.e. the number of DocumentSegments is not the same
-            // as before. Must reinstantiate the entire structure.
-
-            refreshDocumentStructure();
-            return;
+        // New blocks belong to the segment the text was inserted into.
+        for (QTextBlock block = firstBlock; firstBlock != lastBlock && block.isValid() && block.position() <= lastBlock.position(); block = block.next()) {
+            UserData::fromBlock(block).setSegment(m_documentStructure.at(first));
         }
+    }
+}
 
-        DocumentSegment* targetSegment = m_documentStructure.at(startSegment);
+void FormattableTextArea::resetSegmentLengths(const QVector<outline::Entry>& entries)
+{
+    QVector<int> lengths;
+    lengths.reserve(entries.size());
 
-        if (targetSegment) {
-            emit targetSegment->textChanged();
-            targetSegment->updateWordCount();
-        }
+    for (int i = 0; i < entries.size(); i++) {
+        const int end = i < entries.size() - 1 ? entries.at(i + 1).position : m_document->characterCount();
+        lengths.append(end - entries.at(i).position);
     }
+
+    m_segmentLengths.reset(lengths);
 }
 
 void FormattableTextArea::refreshDocumentStructure()
 {
     for (DocumentSegment* segment : m_documentStructure) {
+        segment->unlink();
         segment->deleteLater();
     }
 
     m_documentStructure.clear();
+    m_segmentLengths.clear();
+    m_observedSegments.clear();
 
     if (!m_document) {
+        m_documentStructureModel->reset(m_documentStructure);
         emit documentStructureChanged();
 
         return;
     }
 
-    DocumentSegment* firstSegment = new DocumentSegment(0, 1, this);
-    connect(firstSegment, &DocumentSegment::wordCountChanged, this, &FormattableTextArea::updateWordCount);
-    m_documentStructure.append(firstSegment);
+    const QVector<outline::Entry> entries = outline::entries(m_document);
+    resetSegmentLengths(entries);
 
-    QTextBlock previous = QTextBlock();
-    QTextBlock previousHeading = QTextBlock();
-    QTextBlock block = m_document->firstBlock();
+    for (const outline::Entry& entry : entries) {
+        DocumentSegment* const previousSegment = m_documentStructure.isEmpty() ? nullptr : m_documentStructure.last();
+        DocumentSegment* segment = new DocumentSegment(entry.position, entry.depth, this);
+        segment->appendAfter(previousSegment);
+        connect(segment, &DocumentSegment::wordCountChanged, this, &FormattableTextArea::updateWordCount);
+        m_documentStructure.append(segment);
 
-    while (block.isValid()) {
-        bool isHeading = block.blockFormat().headingLevel() > 0;
-        bool isSubheading = previous.blockFormat().headingLevel() == block.blockFormat().headingLevel() - 1
-                            // uneven headings are considered subheadings
-                            && block.blockFormat().headingLevel() % 2 == 0;
+        if (previousSegment) {
+            emit previousSegment->textChanged();
+        }
+    }
 
-        if (isHeading && !isSubheading) {
-            if (previous.isValid()) {
-                int depth;
-                DocumentSegment* const previousSegment = m_documentStructure.last();
-                const int headingDifference = block.blockFormat().headingLevel() - previousHeading.blockFormat().headingLevel();
+    emit m_documentStructure.last()->textChanged();
+    m_documentStructureModel->reset(m_documentStructure);
 
-                if (!previousHeading.isValid()) {
-                    depth = previousSegment->depth();
-                } else {
-                    depth = previousSegment->depth() + headingDifference;
-                }
+    for (DocumentSegment* segment : m_documentStructure) {
+        tagBlocks(segment);
+    }
 
-                DocumentSegment* segment = new DocumentSegment(block.position(), depth, this);
-                connect(segment, &DocumentSegment::wordCountChanged, this, &FormattableTextArea::updateWordCount);
-                m_documentStructure.append(segment);
+    emit documentStructureChanged();
+    m_currentDocumentSegment = findDocumentSegment(m_textCursor.block());
+    emit currentDocumentSegmentChanged();
 
-                if (previousSegment) {
-                    emit previousSegment->textChanged();
-                }
-            }
+    // Prevent each individual call of segment->updateWordCount()
+    // from calling FormattableTextArea::updateWordCount()
+    const bool wasLoading = m_loading;
+    m_loading = true;
 
-            previousHeading = block;
+    for (DocumentSegment* segment : m_documentStructure) {
+        segment->updateWordCount();
+    }
+
+    m_loading = wasLoading;
+    updateWordCount();
+}
+
+void FormattableTextArea::spliceDocumentStructure(const int from, const int until)
+{
+    if (!m_document || m_documentStructure.isEmpty()) {
+        refreshDocumentStructure();
+        return;
+    }
+
+    // The headings are only determined from the last segment that begins
+    // before the changed blocks until the first segment after them that is
+    // still the same. All segments in between are replaced.
+    const int lastPosition = m_document->characterCount() - 1;
+    const int firstChanged = m_document->findBlock(qBound(0, from, lastPosition)).position();
+    const int lastChanged = m_document->findBlock(qBound(0, until, lastPosition)).position();
+    const int kept = firstChanged > 0 ? m_segmentLengths.indexOf(firstChanged - 1) : 0;
+    const DocumentSegment* keptSegment = m_documentStructure.at(kept);
+    int unchanged = m_documentStructure.size();
+
+    const QVector<outline::Entry> entries = outline::entries(m_document, { keptSegment->position(), keptSegment->depth() },
+                                                             [this, lastChanged, &unchanged](const outline::Entry& entry) {
+        if (entry.position <= lastChanged) {
+            return false;
         }
 
-        previous = block;
-        block = block.next();
+        const int index = m_segmentLengths.indexOf(entry.position);
+
+        if (segmentPosition(index) == entry.position && m_documentStructure.at(index)->depth() == entry.depth) {
+            unchanged = index;
+            return true;
+        }
+
+        return false;
+    });
+
+    const int first = kept + 1;
+    const int removed = unchanged - first;
+    const int added = entries.size() - 1;
+
+    if (removed == 0 && added == 0) {
+        return;
     }
 
-    emit m_documentStructure.last()->textChanged();
-    emit documentStructureChanged();
-    m_currentDocumentSegment = findDocumentSegment(m_textCursor.position());
-    m_lastCaretPosition = m_textCursor.position();
-    emit currentDocumentSegmentChanged();
+    const int end = unchanged < m_documentStructure.size() ? segmentPosition(unchanged) : m_document->characterCount();
+    QVector<int> lengths;
+    lengths.reserve(entries.size());
+
+    for (int i = 0; i < entries.size(); i++) {
+        lengths.append((i < entries.size() - 1 ? entries.at(i + 1).position : end) - entries.at(i).position);
+    }
+
+    const QVector<DocumentSegment*> removedSegments = m_documentStructure.mid(first, removed);
+
+    for (DocumentSegment* segment : removedSegments) {
+        segment->unlink();
+        segment->deleteLater();
+    }
+
+    m_documentStructure.remove(first, removed);
+    m_segmentLengths.remove(first, removed);
+    m_segmentLengths.setValue(kept, lengths.first());
+    m_segmentLengths.insert(first, lengths.mid(1));
+
+    if (m_segmentPositionsChangedFrom > first) {
+        // The indices of the segments with changed positions were shifted.
+        m_segmentPositionsChangedFrom = first;
+    }
+
+    QVector<DocumentSegment*> addedSegments;
+    addedSegments.reserve(added);
+    m_documentStructure.insert(first, added, nullptr);
+
+    for (int i = 1; i < entries.size(); i++) {
+        DocumentSegment* segment = new DocumentSegment(entries.at(i).position, entries.at(i).depth, this);
+        connect(segment, &DocumentSegment::wordCountChanged, this, &FormattableTextArea::updateWordCount);
+        m_documentStructure[kept + i] = segment;
+        addedSegments.append(segment);
+    }
+
+    // The new rows read the indices and positions of their segments as soon
+    // as they are inserted, so the segments have to be linked first.
+    DocumentSegment::link(m_documentStructure, first, first + added, removedSegments);
+    m_documentStructureModel->splice(first, removed, addedSegments);
 
     // Prevent each individual call of segment->updateWordCount()
     // from calling FormattableTextArea::updateWordCount()
+    const bool wasLoading = m_loading;
     m_loading = true;
 
-    for (DocumentSegment* segment : m_documentStructure) {
+    // The segment in front of the splice now ends somewhere else, which
+    // changes its text and word count as well.
+    for (int i = kept; i < first + added; i++) {
+        DocumentSegment* segment = m_documentStructure.at(i);
+        tagBlocks(segment);
+        emit segment->textChanged();
         segment->updateWordCount();
     }
 
-    m_loading = false;
+    m_loading = wasLoading;
+
+    emit documentStructureChanged();
+
+    DocumentSegment* currentSegment = findDocumentSegment(m_textCursor.block());
+
+    if (currentSegment != m_currentDocumentSegment) {
+        m_currentDocumentSegment = currentSegment;
+        emit currentDocumentSegmentChanged();
+    }
+
     updateWordCount();
 }
 
@@ -168,15 +268,40 @@ DocumentSegment* FormattableTextArea::findDocumentSegment(int position) const
         return nullptr;
     }
 
-    DocumentSegment* lastSegment = nullptr;
+    const int index = m_segmentLengths.indexOf(position);
 
-    for (DocumentSegment* segment : m_documentStructure) {
-        if (segment->position() <= position) {
-            lastSegment = segment;
-        } else {
-            break;
-        }
+    return index >= 0 && index < m_documentStructure.size() ? m_documentStructure.at(index) : nullptr;
+}
+
+DocumentSegment* FormattableTextArea::findDocumentSegment(const QTextBlock& block) const
+{
+    if (!block.isValid()) {
+        return nullptr;
+    }
+
+    const UserData* userData = dynamic_cast<const UserData*>(block.userData());
+    DocumentSegment* segment = userData ? userData->segment() : nullptr;
+
+    // Segments that were removed from the structure have an index of -1.
+    if (segment && segment->index() >= 0) {
+        return segment;
     }
 
-    return lastSegment;
+    // Blocks that were inserted since the structure last changed (e.g. by
+    // undoing their removal or while loading) are not tagged yet.
+    segment = findDocumentSegment(block.position());
+
+    QTextBlock taggedBlock = block;
+    UserData::fromBlock(taggedBlock).setSegment(segment);
+
+    return segment;
+}
+
+void FormattableTextArea::tagBlocks(DocumentSegment* segment)
+{
+    const int end = segment->position() + segment->length();
+
+    for (QTextBlock block = m_document->findBlock(segment->position()); block.isValid() && block.position() < end; block = block.next()) {
+        UserData::fromBlock(block).setSegment(segment);
+    }
 }
@@ -4,63 +4,362 @@
 ///                                                                       ///
 /////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <QtConcurrent/QtConcurrent>
+#include <QFutureWatcher>
+#include <QRegularExpression>
+#include <QSharedPointer>
+
 #include "FormattableTextArea.h"
 #include "../UserData.h"
+#include "../searchresults.h"
+
+namespace {
+    //! Documents with fewer characters than this are searched synchronously,
+    //! since starting the workers would take longer than searching.
+    constexpr int BACKGROUND_SEARCH_THRESHOLD = 64 * 1024;
+    //! The number of blocks a single worker searches at once. Each of them
+    //! is reported back as one batch of matches.
+    constexpr int BLOCKS_PER_TASK = 512;
+
+    //! Finds the search string in the text of a block the same way
+    //! QTextDocument::find() does, but without accessing the document,
+    //! so that it can be used from any thread.
+    class Matcher
+    {
+        public:
+            Matcher(const QString& searchString, const FormattableTextArea::SearchOptions options)
+                : m_searchString(searchString)
+                , m_regEx()
+                , m_useRegEx(options.testFlag(FormattableTextArea::SearchOption::RegEx))
+                , m_wholeWords(options.testFlag(FormattableTextArea::SearchOption::WholeWords))
+                , m_caseSensitivity(options.testFlag(FormattableTextArea::SearchOption::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive)
+            {
+                if (m_useRegEx) {
+                    m_regEx = QRegularExpression(searchString, m_caseSensitivity == Qt::CaseSensitive
+                                                 ? QRegularExpression::NoPatternOption
+                                                 : QRegularExpression::CaseInsensitiveOption);
+                }
+            }
+
+            //! Appends all matches in the text of the block at the given
+            //! position that lie within the bounds to the results.
+            void match(QString text, const int position, const Range<int>& bounds, QVector<Range<int>>& results) const
+            {
+                // QTextDocument::find() treats non-breaking spaces as spaces.
+                text.replace(QChar::Nbsp, QLatin1Char(' '));
+                int offset = qMax(bounds.from() - position, 0);
+
+                while (offset <= text.length()) {
+                    int start;
+                    int length;
+
+                    if (m_useRegEx) {
+                        const QRegularExpressionMatch match = m_regEx.match(text, offset);
+
+                        if (!match.hasMatch()) {
+                            return;
+                        }
+
+                        start = match.capturedStart();
+                        length = match.capturedLength();
+                    } else {
+                        start = text.indexOf(m_searchString, offset, m_caseSensitivity);
+                        length = m_searchString.length();
+
+                        if (start < 0) {
+                            return;
+                        }
+                    }
+
+                    const int end = start + length;
+
+                    if (position + end > bounds.until()) {
+                        return;
+                    }
+
+                    // Empty matches can't be highlighted and would otherwise
+                    // be found at the same position over and over again.
+                    if (length == 0 || (m_wholeWords && !isWholeWord(text, start, end))) {
+                        offset = start + 1;
+                        continue;
+                    }
+
+                    results.append(Range<int>(position + start, position + end));
+                    offset = end;
+                }
+            }
+
+        private:
+            static bool isWholeWord(const QString& text, const int start, const int end)
+            {
+                return (start == 0 || !text.at(start - 1).isLetterOrNumber())
+                    && (end == text.length() || !text.at(end).isLetterOrNumber());
+            }
+
+            QString m_searchString;
+            QRegularExpression m_regEx;
+            bool m_useRegEx;
+            bool m_wholeWords;
+            Qt::CaseSensitivity m_caseSensitivity;
+    };
+
+    struct SearchTask {
+        int from;
+        int until;
+    };
+
+    //! A read-only copy of everything the workers need from the document.
+    struct SearchSnapshot {
+        //! The text of the entire document as returned by toRawText().
+        QString text;
+        QVector<int> positions;
+        QVector<int> lengths;
+        Range<int> bounds;
+        Matcher matcher;
+    };
+
+    //! Searches the blocks of a single task. Declares its result type since
+    //! QtConcurrent::mapped() can't deduce it on its own.
+    struct SearchBlocks {
+        typedef QVector<Range<int>> result_type;
+
+        //! Held on to so that the snapshot outlives the workers even if
+        //! the text area is destroyed in the meantime.
+        QSharedPointer<SearchSnapshot> snapshot;
+        QSharedPointer<QAtomicInt> cancelled;
+
+        result_type operator()(const SearchTask& task) const
+        {
+            result_type matches;
+
+            for (int i = task.from; i < task.until && !cancelled->loadRelaxed(); i++) {
+                const int position = snapshot->positions.at(i);
+                snapshot->matcher.match(snapshot->text.mid(position, snapshot->lengths.at(i)), position, snapshot->bounds, matches);
+            }
+
+            return matches;
+        }
+    };
+
+    bool startsBeforeRange(const Range<int>& range, const Range<int>& other)
+    {
+        return range.from() < other.from();
+    }
+}
 
 void FormattableTextArea::find(const QString& searchString, const SearchOptions options)
 {
+    materializeAll();
+    cancelSearch();
+
     m_searchString = searchString;
     m_searchFlags = options;
+    // The results below already reflect all pending changes.
+    m_searchResultsOffset = 0;
 
-    const int previousSearchResultsCount = searchResultCount();
-    QVector<Range<int>> results;
+    if (!m_searching) {
+        m_searchResultCountBeforeSearch = searchResultCount();
+    }
 
     if (searchString.isEmpty()) {
-        this->m_highlighter->setFindRanges(results);
+        this->m_highlighter->setFindRanges(QVector<Range<int>>());
+        finishSearching();
 
-        if (previousSearchResultsCount != searchResultCount()) {
-            emit searchResultCountChanged();
-        }
+        return;
+    }
+
+    const Range<int> bounds = searchBounds();
+
+    if (bounds.length() >= BACKGROUND_SEARCH_THRESHOLD) {
+        findInBackground(bounds.from(), bounds.until());
 
         return;
     }
 
-    QTextDocument::FindFlags flags = 0x0;
-    QTextCursor cursor(m_document);
-    bool stopOnSelection = false;
+    this->m_highlighter->setFindRanges(findMatches(bounds.from(), bounds.until()));
+    finishSearching();
+}
+
+QVector<Range<int>> FormattableTextArea::findMatches(const int from, const int until) const
+{
+    const Matcher matcher(m_searchString, m_searchFlags);
+    const Range<int> bounds(from, until);
+    QVector<Range<int>> results;
 
-    if (options.testFlag(SearchOption::WholeWords)) {
-        flags.setFlag(QTextDocument::FindFlag::FindWholeWords);
+    for (QTextBlock block = m_document->findBlock(from); block.isValid() && block.position() < until; block = block.next()) {
+        matcher.match(block.text(), block.position(), bounds, results);
     }
 
-    if (options.testFlag(SearchOption::CaseSensitive)) {
-        flags.setFlag(QTextDocument::FindFlag::FindCaseSensitively);
+    return results;
+}
+
+Range<int> FormattableTextArea::searchBounds() const
+{
+    if (m_searchFlags.testFlag(SearchOption::InSelection) && m_textCursor.hasSelection()) {
+        return Range<int>(m_textCursor.selectionStart(), m_textCursor.selectionEnd());
+    }
+
+    return Range<int>(0, m_document->characterCount());
+}
+
+void FormattableTextArea::findInBackground(const int from, const int until)
+{
+    const QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_searchCancellation = cancelled;
+
+    // Positions in the raw text are the same as positions in the document,
+    // so a single copy of the text is enough to search every block.
+    const QSharedPointer<SearchSnapshot> snapshot(new SearchSnapshot {
+        m_document->toRawText(), {}, {}, Range<int>(from, until), Matcher(m_searchString, m_searchFlags)
+    });
+
+    for (QTextBlock block = m_document->findBlock(from); block.isValid() && block.position() < until; block = block.next()) {
+        snapshot->positions.append(block.position());
+        snapshot->lengths.append(block.length() - 1);
     }
 
-    if (options.testFlag(SearchOption::InSelection) && m_textCursor.hasSelection()) {
-        cursor.setPosition(m_textCursor.selectionStart());
-        stopOnSelection = true;
+    const int blockCount = snapshot->positions.size();
+    QVector<SearchTask> tasks;
+
+    for (int i = 0; i < blockCount; i += BLOCKS_PER_TASK) {
+        tasks.append({ i, qMin(i + BLOCKS_PER_TASK, blockCount) });
     }
 
-    const bool useRegEx = options.testFlag(SearchOption::RegEx);
-    QRegularExpression regEx = useRegEx ? QRegularExpression(searchString) : QRegularExpression();
+    // The thread pool starts the tasks in order, so the matches the user
+    // can currently see are highlighted first.
+    const int firstVisibleBlock = m_document->findBlock(qMax(hitTest(QPointF(0, 0)), from)).blockNumber()
+                                - m_document->findBlock(from).blockNumber();
+
+    if (firstVisibleBlock > 0 && firstVisibleBlock < blockCount) {
+        std::rotate(tasks.begin(), tasks.begin() + firstVisibleBlock / BLOCKS_PER_TASK, tasks.end());
+    }
+
+    m_searchEditedRange = Range<int>();
+    m_searchEditOffset = 0;
+
+    if (!m_searching) {
+        m_searching = true;
+        emit searchingChanged();
+    }
+
+    if (searchResultCount() > 0) {
+        this->m_highlighter->setFindRanges(QVector<Range<int>>());
+        emit searchResultCountChanged();
+    }
+
+    QFutureWatcher<QVector<Range<int>>>* watcher = new QFutureWatcher<QVector<Range<int>>>(this);
+
+    connect(watcher, &QFutureWatcher<QVector<Range<int>>>::resultsReadyAt, this, [this, watcher, cancelled](int begin, int end) {
+        if (cancelled->loadRelaxed()) {
+            return;
+        }
+
+        // The search results have to reflect all edits before matches
+        // mapped to the current text can be merged into them.
+        if (m_dirtyRange.isValid()) {
+            processChanges();
+
+            if (cancelled->loadRelaxed()) {
+                return;
+            }
+        }
+
+        QVector<Range<int>> matches;
+
+        for (int i = begin; i < end; i++) {
+            matches.append(mapSearchResults(watcher->resultAt(i)));
+        }
+
+        addSearchResults(matches);
+    });
 
-    while (!cursor.isNull()) {
-        if (useRegEx) {
-            cursor = m_document->find(regEx, cursor, flags);
-        } else {
-            cursor = m_document->find(searchString, cursor, flags);
+    connect(watcher, &QFutureWatcher<QVector<Range<int>>>::finished, this, [this, watcher, cancelled] {
+        watcher->deleteLater();
+
+        if (cancelled->loadRelaxed()) {
+            // Superseded by a newer search.
+            return;
         }
 
-        if (!cursor.isNull() && (!stopOnSelection || cursor.selectionEnd() <= m_textCursor.selectionEnd())) {
-            const Range<int> range = Range<int>(cursor.selectionStart(), cursor.selectionEnd());
-            results.append(range);
+        m_searchCancellation.reset();
+
+        if (m_searchEditedRange.isValid()) {
+            if (m_dirtyRange.isValid()) {
+                processChanges();
+            }
+
+            // Matches that were dropped or found twice while the blocks were
+            // being edited are sorted out by searching them one last time.
+            updateFindRanges(m_searchEditedRange, 0);
+            m_searchEditedRange = Range<int>();
+            m_searchEditOffset = 0;
         }
+
+        finishSearching();
+    });
+
+    watcher->setFuture(QtConcurrent::mapped(tasks, SearchBlocks { snapshot, cancelled }));
+}
+
+QVector<Range<int>> FormattableTextArea::mapSearchResults(const QVector<Range<int>>& matches) const
+{
+    return searchresults::map(matches, m_searchEditedRange, m_searchEditOffset);
+}
+
+void FormattableTextArea::addSearchResults(QVector<Range<int>> matches)
+{
+    if (matches.isEmpty()) {
+        return;
     }
 
+    // Each batch is sorted, but batches arrive in any order.
+    std::sort(matches.begin(), matches.end(), startsBeforeRange);
+
+    const QVector<Range<int>>& previousResults = searchResults();
+    QVector<Range<int>> results;
+    results.reserve(previousResults.size() + matches.size());
+
+    std::merge(previousResults.constBegin(), previousResults.constEnd(),
+               matches.constBegin(), matches.constEnd(),
+               std::back_inserter(results), startsBeforeRange);
+
     this->m_highlighter->setFindRanges(results);
+    emit searchResultCountChanged();
+}
 
-    if (previousSearchResultsCount != searchResultCount()) {
+void FormattableTextArea::cancelSearch()
+{
+    if (m_searchCancellation) {
+        m_searchCancellation->storeRelaxed(1);
+        m_searchCancellation.reset();
+    }
+}
+
+void FormattableTextArea::completeSearch()
+{
+    if (!m_searching) {
+        return;
+    }
+
+    cancelSearch();
+
+    const Range<int> bounds = searchBounds();
+    this->m_highlighter->setFindRanges(findMatches(bounds.from(), bounds.until()));
+    finishSearching();
+}
+
+void FormattableTextArea::finishSearching()
+{
+    if (m_searching) {
+        m_searching = false;
+        emit searchingChanged();
+    }
+
+    // Emitted after searching changed so that the final count can be told
+    // apart from the intermediate ones.
+    if (m_searchResultCountBeforeSearch != searchResultCount()) {
+        m_searchResultCountBeforeSearch = searchResultCount();
         emit searchResultCountChanged();
     }
 }
@@ -143,6 +442,8 @@ void FormattableTextArea::clearMatches()
 
 void FormattableTextArea::replaceNext(const QString& text)
 {
+    completeSearch();
+
     if (searchResults().isEmpty()) {
         return;
     }
@@ -176,6 +477,9 @@ void FormattableTextArea::replaceNext(const QString& text)
 
 void FormattableTextArea::replaceAll(const QString& text)
 {
+    // Only replacing the matches found so far would be surprising.
+    completeSearch();
+
     if (searchResults().isEmpty()) {
         return;
     }
@@ -199,16 +503,43 @@ void FormattableTextArea::replaceAll(const QString& text)
     updateActive();
 }
 
-void FormattableTextArea::updateFindRanges()
+void FormattableTextArea::updateFindRanges(const Range<int>& changedRange, const int offset)
 {
+    if (m_searchString.isEmpty()) {
+        return;
+    }
+
+    // The selection moves along with the edit, so searching only
+    // the changed blocks would not produce the same results. A background
+    // search keeps going, its matches are moved along with the edits (see
+    // mapSearchResults()).
+    if (m_searchFlags.testFlag(SearchOption::InSelection)) {
+        find(m_searchString, m_searchFlags);
+        return;
+    }
+
     // Can't check anything based on what characters were added/removed here
     // since inserted characters may have resulted in a new match and
     // removed characters may have resulted in a match being lost.
-    // The only possible optimization would be to limit the find() rerun
-    // to the block(s) in which the changes occurred, but as long as there
-    // is no performance problem, that would be a premature optimization.
+    // QTextDocument::find() never matches across block boundaries though,
+    // so only the blocks in which the changes occurred need to be searched
+    // again. All matches in the blocks after them are still valid and only
+    // need to be moved.
+    const QTextBlock firstBlock = m_document->findBlock(changedRange.from());
+    QTextBlock lastBlock = m_document->findBlock(changedRange.until());
+
+    if (!lastBlock.isValid()) {
+        lastBlock = m_document->lastBlock();
+    }
 
-    if (!m_searchString.isEmpty()) {
-        find(m_searchString, m_searchFlags);
+    const int from = firstBlock.position();
+    const int until = lastBlock.position() + lastBlock.length();
+    const QVector<Range<int>> results = searchresults::splice(searchResults(), from, until, offset, findMatches(from, until));
+
+    const int previousSearchResultsCount = searchResultCount();
+    this->m_highlighter->setFindRanges(results);
+
+    if (previousSearchResultsCount != searchResultCount()) {
+        emit searchResultCountChanged();
     }
 }
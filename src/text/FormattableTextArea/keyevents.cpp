@@ -10,6 +10,13 @@
 
 void FormattableTextArea::keyPressEvent(QKeyEvent* event)
 {
+    if (m_loading) {
+        // The current document is about to be replaced by the one that is
+        // being loaded in the background, so any edit would be lost.
+        event->ignore();
+        return;
+    }
+
     const bool shift = event->modifiers().testFlag(Qt::ShiftModifier);
     const bool ctrl = event->modifiers().testFlag(Qt::ControlModifier);
     const QTextCursor::MoveMode moveMode = shift
@@ -110,6 +117,8 @@ void FormattableTextArea::keyPressEvent(QKeyEvent* event)
             const QString text = symbols::sanitize(event->text());
 
             if (!text.isEmpty() && (m_textCursor.blockFormat() != format::sceneBreakFormat || symbols::isNewLine(text[0]))) {
+                prepareForEdit();
+
                 const int selectionStart = m_textCursor.selectionStart();
                 const int selectionEnd = m_textCursor.selectionEnd();
                 const QChar& previousCharacter = m_document->characterAt(selectionStart - 1);
@@ -0,0 +1,201 @@
+/////////////////////////////////////////////////////////////////////////////
+///                                                                       ///
+///    Contains all code responsible for appending the chunks of large    ///
+///    files that were not parsed during loading.                         ///
+///                                                                       ///
+/////////////////////////////////////////////////////////////////////////////
+
+#include <QTextDocument>
+#include <QtConcurrent/QtConcurrent>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+
+#include "FormattableTextArea.h"
+#include "../wordcount.h"
+
+namespace {
+    //! Parses a pending chunk into a document of its own and counts its
+    //! words. The result type has to be declared explicitly because
+    //! QtConcurrent::mapped() can't deduce it on its own.
+    struct CountChunkWords {
+        typedef int result_type;
+
+        MarkdownParser::BlockFormats blockFormats;
+        wordcount::Rules rules;
+        QSharedPointer<QAtomicInt> cancelled;
+
+        result_type operator()(const QByteArray& markdown) const
+        {
+            if (cancelled->loadRelaxed() != 0) {
+                return 0;
+            }
+
+            QTextDocument document;
+            document.setUndoRedoEnabled(false);
+
+            MarkdownParser parser(&document, blockFormats);
+            parser.setCancellationFlag(cancelled.data());
+            parser.parse(markdown.constData(), markdown.size());
+
+            int words = 0;
+
+            for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+                words += wordcount::count(block, rules);
+            }
+
+            return words;
+        }
+    };
+}
+
+void FormattableTextArea::materializeNext()
+{
+    if (m_pendingChunks.isEmpty()) {
+        m_materializationTimer.stop();
+
+        return;
+    }
+
+    const PendingChunk chunk = m_pendingChunks.takeFirst();
+    m_pendingWordCount -= chunk.wordCount;
+    m_materializedChunkCount++;
+
+    const int position = m_document->characterCount() - 1;
+    const bool wasModified = modified();
+    const bool hadEdits = m_document->availableUndoSteps() > 0;
+    // A caret at the end of the parsed text would otherwise be moved past
+    // the appended text.
+    const int anchor = m_textCursor.anchor();
+    const int caretPosition = m_textCursor.position();
+
+    // The appended text is accounted for in bulk below instead of block
+    // by block in handleTextChange().
+    const bool wasLoading = m_loading;
+    m_loading = true;
+    MarkdownParser(m_document).append(chunk.markdown.constData(), chunk.markdown.size());
+    m_textCursor.setPosition(anchor);
+    m_textCursor.setPosition(caretPosition, QTextCursor::KeepAnchor);
+
+    // The last segment always extends to the end of the document, so it
+    // contains all appended text until the headings in it are found.
+    m_segmentLengths.add(m_segmentLengths.size() - 1, m_document->characterCount() - m_segmentLengths.total());
+
+    countWords(position, m_document->characterCount() - position);
+
+    // Only the last segment and the appended text are looked at, so the
+    // outline grows with every chunk.
+    spliceDocumentStructure(position, m_document->characterCount());
+    m_documentStructure.last()->updateWordCount();
+    m_loading = wasLoading;
+
+    if (hadEdits) {
+        // The append can't be kept off the undo stack, and undoing it would
+        // delete loaded text. The user's edits before it can't be undone
+        // anymore either, since the undo stack is linear.
+        m_undoBarrier = m_document->availableUndoSteps();
+        emit canUndoChanged(canUndo());
+    } else {
+        clearUndoStack();
+    }
+
+    if (!wasModified) {
+        setModified(false);
+    }
+
+    if (m_pendingChunks.isEmpty()) {
+        m_materializationTimer.stop();
+        m_pendingWordCount = 0;
+    }
+
+    updateCounts();
+    applyUntrackedWordCount();
+}
+
+void FormattableTextArea::materializeAll()
+{
+    while (!m_pendingChunks.isEmpty()) {
+        materializeNext();
+    }
+}
+
+void FormattableTextArea::ensureMaterialized(int position)
+{
+    while (!m_pendingChunks.isEmpty() && position >= m_document->characterCount() - 1) {
+        materializeNext();
+    }
+}
+
+void FormattableTextArea::prepareForEdit()
+{
+    // Chunks always start with a heading, so text typed at the end of the
+    // parsed text already is where it belongs once they are appended.
+    m_materializationTimer.stop();
+}
+
+void FormattableTextArea::discardPendingChunks()
+{
+    if (m_pendingCountCancellation) {
+        m_pendingCountCancellation->storeRelaxed(1);
+        m_pendingCountCancellation.reset();
+    }
+
+    m_materializationTimer.stop();
+    m_pendingChunks.clear();
+    m_pendingWordCount = 0;
+    m_materializedChunkCount = 0;
+}
+
+void FormattableTextArea::countPendingChunks()
+{
+    if (m_pendingCountCancellation) {
+        m_pendingCountCancellation->storeRelaxed(1);
+        m_pendingCountCancellation.reset();
+    }
+
+    if (m_pendingChunks.isEmpty()) {
+        return;
+    }
+
+    const QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_pendingCountCancellation = cancelled;
+
+    const int firstChunk = m_materializedChunkCount;
+    QVector<QByteArray> chunks;
+    chunks.reserve(m_pendingChunks.size());
+
+    for (const PendingChunk& chunk : m_pendingChunks) {
+        chunks.append(chunk.markdown);
+    }
+
+    QFutureWatcher<int>* watcher = new QFutureWatcher<int>(this);
+
+    connect(watcher, &QFutureWatcher<int>::finished, this, [this, watcher, cancelled, firstChunk] {
+        watcher->deleteLater();
+
+        if (cancelled->loadRelaxed() != 0) {
+            // Superseded by a newer count or another document.
+            return;
+        }
+
+        m_pendingCountCancellation.reset();
+
+        // Chunks appended in the meantime were counted when they were parsed.
+        const int appended = m_materializedChunkCount - firstChunk;
+        int words = 0;
+
+        for (int i = 0; i < m_pendingChunks.size(); i++) {
+            m_pendingChunks[i].wordCount = watcher->resultAt(appended + i);
+            words += m_pendingChunks.at(i).wordCount;
+        }
+
+        m_pendingWordCount = words;
+        applyUntrackedWordCount();
+    });
+
+    // The block formats are copied for the same reason as in load().
+    watcher->setFuture(QtConcurrent::mapped(chunks, CountChunkWords {
+        MarkdownParser::BlockFormats::fromActiveTheme(),
+        m_wordCountRules,
+        cancelled
+    }));
+}
@@ -89,6 +89,7 @@ void FormattableTextArea::updateDocumentDefaults(bool cloneDocument)
     updateStyling(document);
 
     m_document->setUndoRedoEnabled(true);
+    m_undoBarrier = 0;
 
     if (!wasModified) {
         this->setModified(false);
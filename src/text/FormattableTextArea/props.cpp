@@ -24,6 +24,35 @@ const QVector<DocumentSegment*>& FormattableTextArea::documentStructure() const
     return m_documentStructure;
 }
 
+DocumentStructureModel* FormattableTextArea::documentStructureModel() const
+{
+    return m_documentStructureModel;
+}
+
+const WordCountIndex& FormattableTextArea::wordCountIndex() const
+{
+    return m_wordCountIndex;
+}
+
+int FormattableTextArea::segmentPosition(const int index) const
+{
+    return m_segmentLengths.sumBefore(index);
+}
+
+int FormattableTextArea::segmentLength(const int index) const
+{
+    return m_segmentLengths.value(index);
+}
+
+void FormattableTextArea::observeSegment(DocumentSegment* segment, const bool observe)
+{
+    if (observe) {
+        m_observedSegments.insert(segment);
+    } else {
+        m_observedSegments.remove(segment);
+    }
+}
+
 double FormattableTextArea::contentY() const
 {
     return m_contentY;
@@ -34,6 +63,11 @@ void FormattableTextArea::setContentY(double contentY)
     m_contentY = contentY;
     emit contentYChanged();
 
+    if (!m_pendingChunks.isEmpty() && m_contentY + height() * 2 >= contentHeight()) {
+        // The viewport is about to reach the end of the parsed text.
+        materializeNext();
+    }
+
     update();
 }
 
@@ -59,6 +93,8 @@ void FormattableTextArea::setCaretPosition(int caretPosition)
 {
     int previousPosition = this->caretPosition();
 
+    ensureMaterialized(caretPosition);
+
     if (caretPosition < 0) {
         m_textCursor.movePosition(QTextCursor::MoveOperation::Start);
     } else if (caretPosition > m_document->characterCount() - 1) {
@@ -96,7 +132,7 @@ QDateTime FormattableTextArea::lastModified() const
 
 bool FormattableTextArea::canUndo() const
 {
-    return m_document->isUndoAvailable();
+    return m_document->availableUndoSteps() > m_undoBarrier;
 }
 
 bool FormattableTextArea::canRedo() const
@@ -126,6 +162,11 @@ int FormattableTextArea::searchResultCount() const
     return m_highlighter->findRanges().size();
 }
 
+bool FormattableTextArea::searching() const
+{
+    return m_searching;
+}
+
 QUrl FormattableTextArea::fileUrl() const
 {
     return m_fileUrl;
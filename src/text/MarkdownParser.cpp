@@ -2,29 +2,95 @@
 #include <QDebug>
 #include <QTextDocumentFragment>
 #include <QException>
+#include <QtConcurrent/QtConcurrent>
+#include <QtAlgorithms>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "MarkdownParser.h"
 #include "symbols.h"
 #include "format.h"
+#include "UserData.h"
 
 namespace {
-    QString escape(const QString& string)
+    //! Checks if the character must be preceded by an escape mark when
+    //! written to markdown.
+    inline bool isEscapable(ushort character)
     {
-        QString newString;
+        return character == symbols::italic_mark.unicode()
+            || character == symbols::italic_mark_alt.unicode()
+            || character == symbols::strikethrough_mark.unicode()
+            || character == symbols::escape_mark.unicode();
+    }
 
-        for (const QChar& character : string) {
-            if (character == symbols::italic_mark
-             || character == symbols::italic_mark_alt
-             || character == symbols::strikethrough_mark
-             || character == symbols::escape_mark)
-            {
-                newString += symbols::escape_mark;
+    //! Returns the index of the first character in data that must be
+    //! escaped, or -1 if there is none. Most fragments in a manuscript are
+    //! plain prose, so the search compares eight characters at a time
+    //! where SSE2 is available.
+    int indexOfEscapable(const ushort* data, int size)
+    {
+        int i = 0;
+
+#ifdef __SSE2__
+        const __m128i italic = _mm_set1_epi16(static_cast<short>(symbols::italic_mark.unicode()));
+        const __m128i italicAlt = _mm_set1_epi16(static_cast<short>(symbols::italic_mark_alt.unicode()));
+        const __m128i strikethrough = _mm_set1_epi16(static_cast<short>(symbols::strikethrough_mark.unicode()));
+        const __m128i escape = _mm_set1_epi16(static_cast<short>(symbols::escape_mark.unicode()));
+
+        for (; i + 8 <= size; i += 8) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i matches = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi16(chunk, italic), _mm_cmpeq_epi16(chunk, italicAlt)),
+                _mm_or_si128(_mm_cmpeq_epi16(chunk, strikethrough), _mm_cmpeq_epi16(chunk, escape))
+            );
+            const int mask = _mm_movemask_epi8(matches);
+
+            if (mask != 0) {
+                // Every matching character sets two bits in the mask.
+                return i + qCountTrailingZeroBits(static_cast<quint32>(mask)) / 2;
+            }
+        }
+#endif
+
+        for (; i < size; i++) {
+            if (isEscapable(data[i])) {
+                return i;
             }
+        }
+
+        return -1;
+    }
+
+    void writeEscaped(QTextStream& stream, const QString& string)
+    {
+        const ushort* data = string.utf16();
+        const int size = string.size();
+        int index = indexOfEscapable(data, size);
 
-            newString += character;
+        if (index == -1) {
+            stream << string;
+            return;
+        }
+
+        QString escaped;
+        escaped.reserve(size + 8);
+        int from = 0;
+
+        while (index != -1) {
+            escaped.append(string.constData() + from, index - from);
+            escaped += symbols::escape_mark;
+            escaped += string.at(index);
+            from = index + 1;
+
+            const int next = indexOfEscapable(data + from, size - from);
+            index = next == -1 ? -1 : from + next;
         }
 
-        return newString;
+        escaped.append(string.constData() + from, size - from);
+        stream << escaped;
     }
 
     void writeBlankLine(QTextStream& stream)
@@ -32,83 +98,306 @@ namespace {
         stream << "<br/>" << symbols::newline << symbols::newline;
     }
 
-    void writeFragment(QTextStream& stream, const QTextFragment fragment, QStack<QString>& marks, bool firstFragment)
+    //! The properties of a QTextFragment that are relevant for writing it.
+    struct FragmentSnapshot {
+        QString text;
+        bool bold;
+        bool italic;
+        bool strikethrough;
+    };
+
+    //! A detached copy of everything writeBlock() needs from a QTextBlock.
+    //! Unlike a QTextBlock, a snapshot may safely be written on any thread.
+    struct BlockSnapshot {
+        bool sceneBreak;
+        int headingLevel;
+        QVector<FragmentSnapshot> fragments;
+    };
+
+    //! A range of blocks that is serialized on a single thread.
+    struct SerializationTask {
+        int from;
+        int until;
+        QStringList output;
+    };
+
+    //! Serializing a block costs little. Below this number of blocks,
+    //! distributing the work among threads costs more than it saves.
+    constexpr int BLOCKS_PER_TASK = 256;
+
+    BlockSnapshot snapshot(const QTextBlock& block)
     {
-        const QTextCharFormat& format = fragment.charFormat();
+        const QTextBlockFormat& format = block.blockFormat();
+        BlockSnapshot snapshot { format == format::sceneBreakFormat, format.headingLevel(), {} };
+
+        if (snapshot.sceneBreak) {
+            return snapshot;
+        }
 
-        bool bold = format.fontWeight() > QFont::Bold;
-        bool italic = format.fontItalic();
-        bool strikethrough = format.fontStrikeOut();
-        bool done = false;
+        for (QTextBlock::Iterator iterator = block.begin(); !iterator.atEnd(); iterator++) {
+            const QTextFragment fragment = iterator.fragment();
+            const QTextCharFormat& charFormat = fragment.charFormat();
+
+            snapshot.fragments.append({
+                fragment.text(),
+                charFormat.fontWeight() >= QFont::Bold,
+                charFormat.fontItalic(),
+                charFormat.fontStrikeOut()
+            });
+        }
 
-        while (!done && !marks.isEmpty()) {
-            const QString& top = marks.top();
+        return snapshot;
+    }
 
-            // Close all finished marks in the right order.
+    //! Tracks the emphasis marks that are currently open in a block.
+    //!
+    //! Marks must be closed in the reverse order in which they were opened,
+    //! so besides a bitmask of the open marks, the order in which they were
+    //! opened is kept as a tiny stack of mark indices.
+    class MarkState
+    {
+        public:
+            enum Mark : quint8 { Bold = 0, Italic = 1, Strikethrough = 2 };
 
-            if ((top == symbols::bold_mark && !bold)
-             || (top == symbols::italic_mark && !italic)
-             || (top == symbols::strikethrough_mark && !strikethrough)) {
-                stream << marks.pop();
-            } else {
-                done = true;
+            //! Gets the bitmask of the marks the fragment needs.
+            static quint8 marksOf(const FragmentSnapshot& fragment)
+            {
+                return (fragment.bold ? bit(Bold) : 0)
+                     | (fragment.italic ? bit(Italic) : 0)
+                     | (fragment.strikethrough ? bit(Strikethrough) : 0);
             }
-        }
 
-        if (bold && !marks.contains(symbols::bold_mark)) {
-            stream << symbols::bold_mark;
-            marks.push(symbols::bold_mark);
+            //! Closes all open marks that are no longer wanted. Marks that
+            //! were opened after one of them are closed as well, even if they
+            //! are still wanted, and must be opened again with open().
+            void close(QTextStream& stream, const quint8 wanted)
+            {
+                int kept = 0;
+
+                while (kept < m_depth && (wanted & bit(m_stack[kept]))) {
+                    kept++;
+                }
+
+                while (m_depth > kept) {
+                    closeLast(stream);
+                }
+            }
+
+            //! Opens all wanted marks that aren't open yet.
+            void open(QTextStream& stream, const quint8 wanted)
+            {
+                const quint8 opening = wanted & ~m_open;
+
+                if (opening & bit(Bold)) openMark(stream, Bold);
+                if (opening & bit(Italic)) openMark(stream, Italic);
+                if (opening & bit(Strikethrough)) openMark(stream, Strikethrough);
+            }
+
+            void closeAll(QTextStream& stream)
+            {
+                close(stream, 0);
+            }
+
+        private:
+            quint8 m_open = 0;
+            quint8 m_depth = 0;
+            Mark m_stack[3] {};
+
+            static constexpr quint8 bit(Mark mark)
+            {
+                return static_cast<quint8>(1 << mark);
+            }
+
+            static void writeMark(QTextStream& stream, Mark mark)
+            {
+                switch (mark) {
+                    case Bold: stream << symbols::bold_mark; break;
+                    case Italic: stream << symbols::italic_mark; break;
+                    case Strikethrough: stream << symbols::strikethrough_mark; break;
+                }
+            }
+
+            void openMark(QTextStream& stream, Mark mark)
+            {
+                writeMark(stream, mark);
+                m_stack[m_depth++] = mark;
+                m_open |= bit(mark);
+            }
+
+            void closeLast(QTextStream& stream)
+            {
+                const Mark mark = m_stack[--m_depth];
+                writeMark(stream, mark);
+                m_open &= ~bit(mark);
+            }
+    };
+
+    //! Writes the fragment along with the marks it needs. Markdown doesn't
+    //! recognize marks that have whitespace on their inner side (e.g.
+    //! "**bold **" isn't bold), so whitespace at either end of a fragment is
+    //! written outside of its marks. Trailing whitespace is kept in
+    //! whitespace until the marks that follow it are known. firstText stays
+    //! true until the first text other than whitespace was written.
+    void writeFragment(QTextStream& stream, const FragmentSnapshot& fragment, MarkState& marks, QString& whitespace, bool& firstText)
+    {
+        const QString& text = fragment.text;
+        int from = 0;
+        int until = text.size();
+
+        while (from < until && text.at(from).isSpace()) {
+            from++;
         }
 
-        if (italic && !marks.contains(symbols::italic_mark)) {
-            stream << symbols::italic_mark;
-            marks.push(symbols::italic_mark);
+        while (until > from && text.at(until - 1).isSpace()) {
+            until--;
         }
 
-        if (strikethrough && !marks.contains(symbols::strikethrough_mark)) {
-            stream << symbols::strikethrough_mark;
-            marks.push(symbols::strikethrough_mark);
+        if (from == until) {
+            whitespace += text;
+            return;
         }
 
-        if (firstFragment && fragment.text().startsWith('#')) {
+        const quint8 wanted = MarkState::marksOf(fragment);
+
+        marks.close(stream, wanted);
+        stream << whitespace << text.midRef(0, from);
+        marks.open(stream, wanted);
+
+        if (firstText && text.at(from) == '#') {
             stream << '\\';
         }
 
-        stream << escape(fragment.text());
+        writeEscaped(stream, from == 0 && until == text.size() ? text : text.mid(from, until - from));
+        whitespace = text.mid(until);
+        firstText = false;
     }
 
-    void writeBlock(QTextStream& stream, const QTextBlock& block)
+    void writeBlock(QTextStream& stream, const BlockSnapshot& block)
     {
-        const QTextBlockFormat& format = block.blockFormat();
-
-        if (block.blockFormat() == format::sceneBreakFormat) {
+        if (block.sceneBreak) {
             stream << "---" << symbols::newline << symbols::newline;
             return;
         }
 
-        if (block.text().isEmpty()) {
+        if (block.fragments.isEmpty()) {
             writeBlankLine(stream);
 
             return;
         }
 
-        if (format.headingLevel() > 0) {
-            stream << QStringLiteral("#").repeated(format.headingLevel()) << " ";
+        if (block.headingLevel > 0) {
+            stream << QStringLiteral("#").repeated(block.headingLevel) << " ";
         }
 
-        QStack<QString> marks;
+        MarkState marks;
+        QString whitespace;
 
-        bool firstFragment = true;
-        for (QTextBlock::Iterator iterator = block.begin(); !iterator.atEnd(); iterator++) {
-            writeFragment(stream, iterator.fragment(), marks, firstFragment);
-            firstFragment = false;
+        bool firstText = true;
+
+        for (const FragmentSnapshot& fragment : block.fragments) {
+            writeFragment(stream, fragment, marks, whitespace, firstText);
+        }
+
+        marks.closeAll(stream);
+
+        stream << whitespace << symbols::newline << symbols::newline;
+    }
+
+    QString serialize(const BlockSnapshot& block)
+    {
+        QString markdown;
+        QTextStream stream(&markdown);
+        writeBlock(stream, block);
+        stream.flush();
+
+        return markdown;
+    }
+
+    //! Serializes the snapshots in order. Large numbers of snapshots are
+    //! split into ranges that are serialized in parallel. Since every
+    //! snapshot is serialized by the same function either way, the output
+    //! does not depend on whether it was produced in parallel.
+    QStringList serialize(const QVector<BlockSnapshot>& snapshots)
+    {
+        QStringList output;
+        output.reserve(snapshots.size());
+
+        if (snapshots.size() < BLOCKS_PER_TASK * 2) {
+            for (const BlockSnapshot& snapshot : snapshots) {
+                output.append(serialize(snapshot));
+            }
+
+            return output;
         }
 
-        while (!marks.isEmpty()) {
-            stream << marks.pop();
+        QVector<SerializationTask> tasks;
+
+        for (int i = 0; i < snapshots.size(); i += BLOCKS_PER_TASK) {
+            tasks.append({ i, qMin(i + BLOCKS_PER_TASK, int(snapshots.size())), {} });
+        }
+
+        QtConcurrent::blockingMap(tasks, [&snapshots](SerializationTask& task) {
+            task.output.reserve(task.until - task.from);
+
+            for (int i = task.from; i < task.until; i++) {
+                task.output.append(serialize(snapshots.at(i)));
+            }
+        });
+
+        for (const SerializationTask& task : tasks) {
+            output.append(task.output);
         }
 
-        stream << symbols::newline << symbols::newline;
+        return output;
+    }
+
+    //! Checks if the line is an ATX heading, i.e. starts with one to six
+    //! '#' that are followed by whitespace or the end of the line.
+    bool isAtxHeading(const char* line, const char* end)
+    {
+        int level = 0;
+
+        while (line + level < end && line[level] == '#') {
+            level++;
+        }
+
+        if (level == 0 || level > 6) {
+            return false;
+        }
+
+        return line + level == end || line[level] == ' ' || line[level] == '\t'
+            || line[level] == '\n' || line[level] == '\r';
+    }
+
+    //! Returns the length of the code fence the line starts with, or 0 if it
+    //! doesn't start with one. The fence character is written to character.
+    int codeFenceLength(const char* line, const char* end, char& character)
+    {
+        int indentation = 0;
+
+        while (indentation < 3 && line + indentation < end && line[indentation] == ' ') {
+            indentation++;
+        }
+
+        line += indentation;
+
+        if (line == end || (*line != '`' && *line != '~')) {
+            return 0;
+        }
+
+        int length = 0;
+
+        while (line + length < end && line[length] == *line) {
+            length++;
+        }
+
+        if (length < 3) {
+            return 0;
+        }
+
+        character = *line;
+
+        return length;
     }
 }
 
@@ -156,11 +445,16 @@ const QTextCharFormat MarkdownParser::CHAR_FORMAT_STRIKETHROUGH_INV = []{
     return format;
 }();
 
-MarkdownParser::MarkdownParser(QTextDocument* document) :
+MarkdownParser::MarkdownParser(QTextDocument* document, const BlockFormats& blockFormats) :
     m_document(document),
     m_textCursor(new QTextCursor(document)),
     m_formatStack(),
-    m_flags(None)
+    m_charFormat(),
+    m_blockText(),
+    m_blockFormats(),
+    m_flags(None),
+    m_cancellationFlag(nullptr),
+    m_themeFormats(blockFormats)
 {
     m_parse_info = {
         0, // abi_version
@@ -175,11 +469,16 @@ MarkdownParser::MarkdownParser(QTextDocument* document) :
     };
 }
 
-MarkdownParser::MarkdownParser(QTextCursor* cursor) :
+MarkdownParser::MarkdownParser(QTextCursor* cursor, const BlockFormats& blockFormats) :
     m_document(cursor->document()),
     m_textCursor(cursor),
     m_formatStack(),
-    m_flags(None)
+    m_charFormat(),
+    m_blockText(),
+    m_blockFormats(),
+    m_flags(None),
+    m_cancellationFlag(nullptr),
+    m_themeFormats(blockFormats)
 {
     m_parse_info = {
         0, // abi_version
@@ -194,14 +493,100 @@ MarkdownParser::MarkdownParser(QTextCursor* cursor) :
     };
 }
 
-void MarkdownParser::parse(const QString& string)
+MarkdownParser::BlockFormats MarkdownParser::BlockFormats::fromActiveTheme()
+{
+    const Theme* theme = ThemeManager::instance()->activeTheme();
+    BlockFormats formats { theme->blockFormat(), {} };
+
+    for (int level = 1; level <= 6; level++) {
+        formats.headings.append(theme->headingFormat(level).blockFormat());
+    }
+
+    return formats;
+}
+
+bool MarkdownParser::parse(const QString& string)
+{
+    const QByteArray byteArray = string.toUtf8();
+
+    return parse(byteArray.constData(), byteArray.size());
+}
+
+bool MarkdownParser::parse(const char* data, qint64 size)
 {
     m_document->setUndoRedoEnabled(false);
     m_document->clear();
-    QByteArray byteArray = string.toUtf8();
 
-    md_parse(byteArray.constData(), MD_SIZE(byteArray.size()), &m_parse_info, this);
+    m_charFormat = m_textCursor->charFormat();
+
+    // A single edit block makes the document emit only one change
+    // notification for the whole parse instead of one per insertion.
+    m_textCursor->beginEditBlock();
+    const int result = md_parse(data, MD_SIZE(size), &m_parse_info, this);
+    flushBlock();
+    m_textCursor->endEditBlock();
+
     m_document->setUndoRedoEnabled(true);
+
+    return result == 0;
+}
+
+bool MarkdownParser::append(const char* data, qint64 size)
+{
+    m_textCursor->movePosition(QTextCursor::End);
+    // The cursor's format is that of the last character in the document,
+    // which may be emphasized. Appended text starts out unformatted, just
+    // like the text of an empty document in parse().
+    m_charFormat = QTextCharFormat();
+    m_flags |= ParserFlags::Appending;
+
+    m_textCursor->beginEditBlock();
+    const int result = md_parse(data, MD_SIZE(size), &m_parse_info, this);
+    flushBlock();
+    m_textCursor->endEditBlock();
+
+    m_flags &= ~ParserFlags::Appending;
+
+    return result == 0;
+}
+
+QVector<qint64> MarkdownParser::headingOffsets(const char* data, qint64 size)
+{
+    QVector<qint64> offsets;
+    const char* const end = data + size;
+    const char* line = data;
+    // The character and length of the fence of the code block the current
+    // line is part of, if any.
+    char fenceCharacter = 0;
+    int fenceLength = 0;
+
+    while (line < end) {
+        char character = 0;
+        const int length = codeFenceLength(line, end, character);
+
+        if (fenceCharacter) {
+            if (character == fenceCharacter && length >= fenceLength) {
+                fenceCharacter = 0;
+            }
+        } else if (length > 0) {
+            fenceCharacter = character;
+            fenceLength = length;
+        } else if (isAtxHeading(line, end)) {
+            offsets.append(line - data);
+        }
+
+        // memchr() is far faster than looking at every byte ourselves, and
+        // only the bytes at the start of a line are of interest.
+        line = static_cast<const char*>(memchr(line, '\n', size_t(end - line)));
+
+        if (!line) {
+            break;
+        }
+
+        line++;
+    }
+
+    return offsets;
 }
 
 QString MarkdownParser::stringify() const
@@ -213,12 +598,71 @@ QString MarkdownParser::stringify() const
     return stream.readAll();
 }
 
+void MarkdownParser::setCancellationFlag(const QAtomicInt* flag)
+{
+    m_cancellationFlag = flag;
+}
+
+bool MarkdownParser::isCancelled() const
+{
+    return m_cancellationFlag && m_cancellationFlag->loadRelaxed() != 0;
+}
+
 void MarkdownParser::write(QTextStream& stream) const
 {
-    QTextBlock block = m_document->begin();
+    for (const QString& block : serializeBlocks()) {
+        stream << block;
+    }
+}
+
+QStringList MarkdownParser::serializeBlocks() const
+{
+    QStringList blocks;
+    blocks.reserve(m_document->blockCount());
+
+    // Blocks whose cache is out of date are snapshotted here (QTextBlocks
+    // must not be accessed from other threads) and serialized afterwards,
+    // possibly in parallel.
+    QVector<int> staleIndices;
+    QVector<QTextBlock> staleBlocks;
+    QVector<BlockSnapshot> snapshots;
+
+    for (QTextBlock block = m_document->begin(); block.isValid(); block = block.next()) {
+        UserData& userData = UserData::fromBlock(block);
+
+        if (userData.hasMarkdown(block.revision())) {
+            blocks.append(userData.markdown());
+        } else {
+            staleIndices.append(blocks.size());
+            staleBlocks.append(block);
+            snapshots.append(snapshot(block));
+            blocks.append(QString());
+        }
+    }
+
+    const QStringList serialized = serialize(snapshots);
+
+    for (int i = 0; i < serialized.size(); i++) {
+        QTextBlock& block = staleBlocks[i];
+        UserData::fromBlock(block).setMarkdown(serialized.at(i), block.revision());
+        blocks[staleIndices.at(i)] = serialized.at(i);
+    }
+
+    return blocks;
+}
+
+void MarkdownParser::invalidate(QTextDocument* document, int position, int length)
+{
+    QTextBlock block = document->findBlock(position);
+    const int end = position + length;
+
+    while (block.isValid() && block.position() <= end) {
+        UserData* userData = dynamic_cast<UserData*>(block.userData());
+
+        if (userData) {
+            userData->invalidateMarkdown();
+        }
 
-    while (block.isValid()) {
-        writeBlock(stream, block);
         block = block.next();
     }
 }
@@ -255,11 +699,22 @@ int MarkdownParser::onText(MD_TEXTTYPE type, const MD_CHAR* text, MD_SIZE size,
 
 int MarkdownParser::onEnterBlock(MD_BLOCKTYPE type, void* detail)
 {
+    // Any non-zero return value makes md4c abort the parse. Checking once
+    // per block is frequent enough to make cancellation feel immediate.
+    if (isCancelled()) {
+        return 1;
+    }
+
     if (type == MD_BLOCK_DOC) {
-        m_flags |= ParserFlags::NoNewBlockNeeded;
+        if (!(m_flags & ParserFlags::Appending)) {
+            m_flags |= ParserFlags::NoNewBlockNeeded;
+        }
+
         return 0;
     }
 
+    flushBlock();
+
     if (type == MD_BLOCK_HR) {
         m_textCursor->insertBlock(format::sceneBreakFormat);
         return 0;
@@ -268,13 +723,13 @@ int MarkdownParser::onEnterBlock(MD_BLOCKTYPE type, void* detail)
     if (type == MD_BLOCK_H)
     {
         const auto* headingDetail = static_cast<MD_BLOCK_H_DETAIL*>(detail);
-        const HeadingFormat& headingFormat = ThemeManager::instance()->activeTheme()->headingFormat(headingDetail->level);
+        const QTextBlockFormat& headingFormat = m_themeFormats.headings.at(int(headingDetail->level) - 1);
 
         if (m_flags & ParserFlags::NoNewBlockNeeded) {
             m_flags &= ~ParserFlags::NoNewBlockNeeded;
-            m_textCursor->setBlockFormat(headingFormat.blockFormat());
+            m_textCursor->setBlockFormat(headingFormat);
         } else {
-            m_textCursor->insertBlock(headingFormat.blockFormat());
+            m_textCursor->insertBlock(headingFormat);
         }
 
         return 0;
@@ -282,9 +737,9 @@ int MarkdownParser::onEnterBlock(MD_BLOCKTYPE type, void* detail)
 
     if (m_flags & ParserFlags::NoNewBlockNeeded) {
         m_flags &= ~ParserFlags::NoNewBlockNeeded;
-        m_textCursor->setBlockFormat(ThemeManager::instance()->activeTheme()->blockFormat());
+        m_textCursor->setBlockFormat(m_themeFormats.paragraph);
     } else {
-        m_textCursor->insertBlock(ThemeManager::instance()->activeTheme()->blockFormat());
+        m_textCursor->insertBlock(m_themeFormats.paragraph);
     }
 
     return 0;
@@ -348,7 +803,7 @@ int MarkdownParser::onText(MD_TEXTTYPE type, const MD_CHAR* text, MD_SIZE size)
             // If the line contains a <br/> tag or a variation thereof,
             // do nothing (i.e. leave the line empty).
 
-            m_textCursor->insertText(string);
+            appendText(string);
         }
     }
 
@@ -363,13 +818,40 @@ void MarkdownParser::toggleFormat(const QTextCharFormat& format)
         // Nested format of the same type or just regular ending.
         // Remove it from the stack and return to regular format.
         m_formatStack.removeOne(invertedFormat);
-        m_textCursor->mergeCharFormat(invertedFormat);
+        m_charFormat.merge(invertedFormat);
     } else {
         m_formatStack.push(inverted(format));
-        m_textCursor->mergeCharFormat(format);
+        m_charFormat.merge(format);
     }
 }
 
+void MarkdownParser::appendText(const QString& text)
+{
+    if (!m_blockFormats.isEmpty() && m_blockFormats.last().format == m_charFormat) {
+        m_blockFormats.last().length += text.length();
+    } else {
+        QTextLayout::FormatRange range;
+        range.start = m_blockText.length();
+        range.length = text.length();
+        range.format = m_charFormat;
+        m_blockFormats.append(range);
+    }
+
+    m_blockText.append(text);
+}
+
+void MarkdownParser::flushBlock()
+{
+    for (const QTextLayout::FormatRange& range : m_blockFormats) {
+        m_textCursor->insertText(m_blockText.mid(range.start, range.length), range.format);
+    }
+
+    // resize() instead of clear() retains the allocated capacity
+    // for the next block.
+    m_blockText.resize(0);
+    m_blockFormats.clear();
+}
+
 const QTextCharFormat& MarkdownParser::getCharFormat(MD_SPANTYPE type)
 {
     switch (type) {
@@ -6,6 +6,8 @@
 #include <QTextCursor>
 #include <QStack>
 #include <QTextStream>
+#include <QTextLayout>
+#include <QAtomicInt>
 #include <md4c/src/md4c.h>
 
 #include "../theming/ThemeManager.h"
@@ -13,26 +15,82 @@
 class MarkdownParser
 {
     public:
+        //! The block formats the parser applies to paragraphs and headings.
+        //! They are copied from the theme up front because the theme may
+        //! only be accessed on the GUI thread, while parsing may happen
+        //! on any thread.
+        struct BlockFormats {
+            QTextBlockFormat paragraph;
+            //! The formats of the heading levels 1 to 6.
+            QVector<QTextBlockFormat> headings;
+
+            //! Copies the formats of the active theme. Must be called on
+            //! the GUI thread.
+            static BlockFormats fromActiveTheme();
+        };
+
         //! Constructs a new MarkdownParser with the specified document
         //! and creates a new cursor that will iterate through the document
         //! from beginning to end.
-        MarkdownParser(QTextDocument* document);
+        MarkdownParser(QTextDocument* document, const BlockFormats& blockFormats = BlockFormats::fromActiveTheme());
         //! Constructs a new MarkdownParser from the specified QTextCursor
         //! and iterates through the document from the cursor's current
         //! position.
-        MarkdownParser(QTextCursor* cursor);
+        MarkdownParser(QTextCursor* cursor, const BlockFormats& blockFormats = BlockFormats::fromActiveTheme());
 
         //! Parses the specified string as markdown and inserts it into the
-        //! document at the cursor's position.
-        void parse(const QString& string);
+        //! document at the cursor's position. Returns false if the parse
+        //! was cancelled before it could finish.
+        bool parse(const QString& string);
+        //! Parses the specified UTF-8 encoded markdown and inserts it into
+        //! the document at the cursor's position. The bytes are passed to
+        //! md4c as they are, without being copied or decoded as a whole,
+        //! which makes this overload suitable for memory-mapped files.
+        //! Returns false if the parse was cancelled before it could finish.
+        bool parse(const char* data, qint64 size);
+        //! Parses the specified UTF-8 encoded markdown and appends it to the
+        //! end of the document as new blocks. Unlike parse(), the existing
+        //! contents of the document are left untouched. Note that the
+        //! insertion is recorded on the undo stack if undo is enabled.
+        //! Returns false if the parse was cancelled before it could finish.
+        bool append(const char* data, qint64 size);
+        //! Returns the byte offsets of all lines in the UTF-8 encoded
+        //! markdown that begin with an ATX heading outside of fenced code.
+        //! Since such a heading always starts a new block, the markdown
+        //! between two of these offsets can be parsed independently of
+        //! the rest.
+        static QVector<qint64> headingOffsets(const char* data, qint64 size);
         //! Turns the document into markdown.
         QString stringify() const;
         //! Writes the contents of the document into the passed QTextStream.
+        //! Each block's markdown is cached in its UserData, so only blocks
+        //! that changed since the last write are serialized again. Large
+        //! numbers of changed blocks are serialized in parallel.
         void write(QTextStream& stream) const;
+        //! Serializes the document into a list of markdown strings, one per
+        //! block. The strings are implicitly shared with each block's cache,
+        //! so for unchanged blocks this costs no more than a reference count
+        //! increment. This makes the result a cheap snapshot of the document
+        //! that can be written to disk on another thread.
+        QStringList serializeBlocks() const;
+
+        //! Discards the cached markdown of all blocks between position and
+        //! position + length (inclusive). Must be called for every change
+        //! to the document since format changes don't change the revision
+        //! of a block.
+        static void invalidate(QTextDocument* document, int position, int length);
+
+        //! Sets a flag that is polled while parsing. As soon as the flag
+        //! becomes non-zero, the parse is aborted. This allows documents
+        //! that are parsed on a worker thread to be discarded early.
+        void setCancellationFlag(const QAtomicInt* flag);
 
         enum ParserFlags {
             None = 0,
-            NoNewBlockNeeded = 1
+            NoNewBlockNeeded = 1,
+            //! The parsed blocks are appended to existing content, so even
+            //! the first block needs a new QTextBlock.
+            Appending = 2
         };
 
     private:
@@ -56,6 +114,13 @@ class MarkdownParser
         static const QTextCharFormat CHAR_FORMAT_STRIKETHROUGH_INV;
 
         void toggleFormat(const QTextCharFormat& format);
+        bool isCancelled() const;
+        //! Appends the text to the pending block using the current
+        //! character format.
+        void appendText(const QString& text);
+        //! Inserts the pending block's text into the document, one
+        //! insertion per format run, and clears the pending block.
+        void flushBlock();
 
         static const QTextCharFormat& getCharFormat(MD_SPANTYPE type);
         static const QTextCharFormat& inverted(const QTextCharFormat& format);
@@ -64,7 +129,19 @@ class MarkdownParser
         QTextDocument* m_document;
         QTextCursor* m_textCursor;
         QStack<QTextCharFormat> m_formatStack;
+        //! The character format that text is currently appended with.
+        //! Spans merge into this format instead of into the cursor's.
+        QTextCharFormat m_charFormat;
+        //! The text of the block that is currently being parsed.
+        //! Text is collected here and only inserted into the document
+        //! once the block is complete.
+        QString m_blockText;
+        //! The format runs of m_blockText. Adjacent text with the same
+        //! format is merged into a single run.
+        QVector<QTextLayout::FormatRange> m_blockFormats;
         int m_flags;
+        const QAtomicInt* m_cancellationFlag;
+        BlockFormats m_themeFormats;
 };
 
 #endif // MARKDOWNPARSER_H
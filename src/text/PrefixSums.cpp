@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <numeric>
+
+#include "PrefixSums.h"
+
+namespace {
+    //! The number of values a chunk holds after reset() or a split.
+    constexpr int CHUNK_SIZE = 64;
+    //! Chunks that grow beyond this many values are split.
+    constexpr int MAX_CHUNK_SIZE = 2 * CHUNK_SIZE;
+
+    //! Gets the value of the lowest set bit of i.
+    inline int lowbit(int i)
+    {
+        return i & -i;
+    }
+
+    //! Adds the difference to the node of the chunk at the specified index
+    //! and to all nodes that contain it.
+    void addToTree(QVector<int>& tree, const int chunk, const int difference)
+    {
+        if (difference == 0) {
+            return;
+        }
+
+        for (int i = chunk + 1; i < tree.size(); i += lowbit(i)) {
+            tree[i] += difference;
+        }
+    }
+
+    //! Gets the sum of the first count chunks.
+    int sumOfTree(const QVector<int>& tree, const int count)
+    {
+        int sum = 0;
+
+        for (int i = count; i > 0; i -= lowbit(i)) {
+            sum += tree.at(i);
+        }
+
+        return sum;
+    }
+
+    //! Descends the tree from the largest power of two, which finds the
+    //! largest number of chunks whose sum is not greater than the limit.
+    //! Their sum is subtracted from the limit.
+    int descend(const QVector<int>& tree, int& limit)
+    {
+        const int size = tree.size() - 1;
+        int count = 0;
+        int step = 1;
+
+        while (step * 2 <= size) {
+            step *= 2;
+        }
+
+        for (; step > 0; step /= 2) {
+            if (count + step <= size && tree.at(count + step) <= limit) {
+                count += step;
+                limit -= tree.at(count);
+            }
+        }
+
+        return count;
+    }
+
+    int sumOf(const QVector<int>& values, const int from, const int until)
+    {
+        return std::accumulate(values.constBegin() + from, values.constBegin() + until, 0);
+    }
+}
+
+PrefixSums::PrefixSums() : m_chunks(), m_sums(1, 0), m_sizes(1, 0), m_size(0)
+{
+}
+
+void PrefixSums::reset(const QVector<int>& values)
+{
+    m_chunks.clear();
+    m_chunks.reserve((values.size() + CHUNK_SIZE - 1) / CHUNK_SIZE);
+
+    for (int i = 0; i < values.size(); i += CHUNK_SIZE) {
+        m_chunks.append(values.mid(i, CHUNK_SIZE));
+    }
+
+    m_size = values.size();
+    rebuildTrees();
+}
+
+void PrefixSums::clear()
+{
+    m_chunks.clear();
+    m_sums.fill(0, 1);
+    m_sizes.fill(0, 1);
+    m_size = 0;
+}
+
+int PrefixSums::size() const
+{
+    return m_size;
+}
+
+int PrefixSums::value(int index) const
+{
+    if (index < 0 || index >= size()) {
+        return 0;
+    }
+
+    int indexInChunk;
+    const int chunk = findChunk(index, indexInChunk);
+
+    return m_chunks.at(chunk).at(indexInChunk);
+}
+
+void PrefixSums::setValue(int index, int value)
+{
+    if (index < 0 || index >= size()) {
+        return;
+    }
+
+    add(index, value - this->value(index));
+}
+
+void PrefixSums::add(int index, int difference)
+{
+    if (index < 0 || index >= size() || difference == 0) {
+        return;
+    }
+
+    int indexInChunk;
+    const int chunk = findChunk(index, indexInChunk);
+
+    m_chunks[chunk][indexInChunk] += difference;
+    addToTree(m_sums, chunk, difference);
+}
+
+void PrefixSums::insert(int index, const QVector<int>& values)
+{
+    if (values.isEmpty()) {
+        return;
+    }
+
+    if (m_chunks.isEmpty()) {
+        reset(values);
+        return;
+    }
+
+    index = qBound(0, index, size());
+
+    int chunk;
+    int indexInChunk;
+
+    if (index == size()) {
+        chunk = m_chunks.size() - 1;
+        indexInChunk = m_chunks.last().size();
+    } else {
+        chunk = findChunk(index, indexInChunk);
+    }
+
+    QVector<int>& chunkValues = m_chunks[chunk];
+    chunkValues.insert(indexInChunk, values.size(), 0);
+    std::copy(values.constBegin(), values.constEnd(), chunkValues.begin() + indexInChunk);
+    m_size += values.size();
+
+    if (!splitChunk(chunk)) {
+        addToTree(m_sums, chunk, sumOf(values, 0, values.size()));
+        addToTree(m_sizes, chunk, values.size());
+    }
+}
+
+void PrefixSums::remove(int index, int count)
+{
+    if (index < 0 || index >= size()) {
+        return;
+    }
+
+    count = qMin(count, size() - index);
+
+    if (count <= 0) {
+        return;
+    }
+
+    int indexInChunk;
+    int chunk = findChunk(index, indexInChunk);
+    bool chunksEmptied = false;
+
+    m_size -= count;
+
+    while (count > 0) {
+        QVector<int>& chunkValues = m_chunks[chunk];
+        const int removed = qMin(count, chunkValues.size() - indexInChunk);
+
+        addToTree(m_sums, chunk, -sumOf(chunkValues, indexInChunk, indexInChunk + removed));
+        addToTree(m_sizes, chunk, -removed);
+        chunkValues.remove(indexInChunk, removed);
+        chunksEmptied = chunksEmptied || chunkValues.isEmpty();
+
+        count -= removed;
+        chunk++;
+        indexInChunk = 0;
+    }
+
+    if (m_chunks.size() > 2 * (m_size / CHUNK_SIZE) + 1) {
+        // Too many chunks were left with only a few values each.
+        QVector<int> values;
+        values.reserve(m_size);
+
+        for (const QVector<int>& chunkValues : qAsConst(m_chunks)) {
+            values.append(chunkValues);
+        }
+
+        reset(values);
+    } else if (chunksEmptied) {
+        m_chunks.erase(std::remove_if(m_chunks.begin(), m_chunks.end(), [](const QVector<int>& chunkValues) {
+            return chunkValues.isEmpty();
+        }), m_chunks.end());
+        rebuildTrees();
+    }
+}
+
+int PrefixSums::sumBefore(int index) const
+{
+    index = qBound(0, index, size());
+
+    if (index == size()) {
+        return total();
+    }
+
+    int indexInChunk;
+    const int chunk = findChunk(index, indexInChunk);
+
+    return sumOfTree(m_sums, chunk) + sumOf(m_chunks.at(chunk), 0, indexInChunk);
+}
+
+int PrefixSums::sum(int from, int until) const
+{
+    if (until <= from) {
+        return 0;
+    }
+
+    return sumBefore(until) - sumBefore(from);
+}
+
+int PrefixSums::total() const
+{
+    return sumOfTree(m_sums, m_chunks.size());
+}
+
+int PrefixSums::indexOf(int offset) const
+{
+    if (m_size == 0) {
+        return -1;
+    }
+
+    // Whole chunks are skipped using the tree, so only the values of a
+    // single chunk need to be looked at.
+    int remaining = offset;
+    const int chunk = descend(m_sums, remaining);
+    int count = sumOfTree(m_sizes, chunk);
+
+    if (chunk < m_chunks.size()) {
+        for (const int value : m_chunks.at(chunk)) {
+            if (value > remaining) {
+                break;
+            }
+
+            remaining -= value;
+            count++;
+        }
+    }
+
+    return qMin(count, size() - 1);
+}
+
+int PrefixSums::findChunk(int index, int& indexInChunk) const
+{
+    // Chunks are never empty, so the chunk that contains the index is the
+    // one after all chunks that together hold no more than index values.
+    indexInChunk = index;
+
+    return descend(m_sizes, indexInChunk);
+}
+
+void PrefixSums::rebuildTrees()
+{
+    const int count = m_chunks.size();
+    m_sums.fill(0, count + 1);
+    m_sizes.fill(0, count + 1);
+
+    // Builds the trees in linear time by pushing each node's sum up to its
+    // parent once, instead of calling addToTree() for every chunk.
+    for (int i = 1; i <= count; i++) {
+        const QVector<int>& chunkValues = m_chunks.at(i - 1);
+        m_sums[i] += sumOf(chunkValues, 0, chunkValues.size());
+        m_sizes[i] += chunkValues.size();
+
+        const int parent = i + lowbit(i);
+
+        if (parent <= count) {
+            m_sums[parent] += m_sums.at(i);
+            m_sizes[parent] += m_sizes.at(i);
+        }
+    }
+}
+
+bool PrefixSums::splitChunk(int chunk)
+{
+    if (m_chunks.at(chunk).size() <= MAX_CHUNK_SIZE) {
+        return false;
+    }
+
+    const QVector<int> values = m_chunks.at(chunk);
+    QVector<QVector<int>> chunks;
+    chunks.reserve(m_chunks.size() + values.size() / CHUNK_SIZE);
+    chunks.append(m_chunks.mid(0, chunk));
+
+    for (int i = 0; i < values.size(); i += CHUNK_SIZE) {
+        chunks.append(values.mid(i, CHUNK_SIZE));
+    }
+
+    chunks.append(m_chunks.mid(chunk + 1));
+    m_chunks = chunks;
+    rebuildTrees();
+
+    return true;
+}
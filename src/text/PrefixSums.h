@@ -0,0 +1,68 @@
+#ifndef PREFIXSUMS_H
+#define PREFIXSUMS_H
+
+#include <QVector>
+
+//! Stores a sequence of non-negative integers together with their prefix
+//! sums, so that changing a value as well as summing up any range of values
+//! takes logarithmic time. The values are kept in small chunks whose sums
+//! and sizes are stored in Fenwick trees, so that values can also be
+//! inserted and removed anywhere without rebuilding everything after them.
+class PrefixSums
+{
+    public:
+        PrefixSums();
+
+        //! Replaces all values. This takes linear time.
+        void reset(const QVector<int>& values);
+        void clear();
+
+        int size() const;
+
+        int value(int index) const;
+        void setValue(int index, int value);
+        void add(int index, int difference);
+
+        //! Inserts the values before the specified index, or appends them
+        //! if the index equals size().
+        void insert(int index, const QVector<int>& values);
+        //! Removes count values beginning at the specified index.
+        void remove(int index, int count);
+
+        //! Gets the sum of all values before the specified index.
+        int sumBefore(int index) const;
+        //! Gets the sum of the values from index from (inclusive) until
+        //! index until (exclusive).
+        int sum(int from, int until) const;
+        //! Gets the sum of all values.
+        int total() const;
+
+        //! Gets the largest index whose sumBefore() is not greater than the
+        //! offset, i.e. the index of the value that contains the offset if
+        //! the values are regarded as consecutive lengths. Returns the last
+        //! index for offsets beyond total(), and -1 if there are no values.
+        int indexOf(int offset) const;
+
+    private:
+        //! Gets the index of the chunk that contains the value at the
+        //! specified index, and the index of the value within that chunk.
+        int findChunk(int index, int& indexInChunk) const;
+        //! Rebuilds both trees from the chunks. This takes linear time in
+        //! the number of chunks.
+        void rebuildTrees();
+        //! Splits the chunk into chunks of the regular size if it grew too
+        //! large. Returns true if it did.
+        bool splitChunk(int chunk);
+
+        //! None of the chunks is ever empty.
+        QVector<QVector<int>> m_chunks;
+        //! Index i (starting at 1) holds the sum of the values in the chunks
+        //! (i - lowbit(i), i].
+        QVector<int> m_sums;
+        //! Index i (starting at 1) holds the number of values in the chunks
+        //! (i - lowbit(i), i].
+        QVector<int> m_sizes;
+        int m_size;
+};
+
+#endif // PREFIXSUMS_H
@@ -1,6 +1,7 @@
 #include "UserData.h"
+#include "DocumentSegment.h"
 
-UserData::UserData() : m_wordCount(0), m_comments()
+UserData::UserData() : m_wordCount(0), m_comments(), m_markdown(), m_markdownRevision(-1), m_segment()
 { }
 
 UserData& UserData::fromBlock(QTextBlock& block) {
@@ -38,3 +39,35 @@ const QVector<Range<int>> UserData::comments() const
 {
     return m_comments;
 }
+
+const QString& UserData::markdown() const
+{
+    return m_markdown;
+}
+
+void UserData::setMarkdown(const QString& markdown, int revision)
+{
+    m_markdown = markdown;
+    m_markdownRevision = revision;
+}
+
+bool UserData::hasMarkdown(int revision) const
+{
+    return m_markdownRevision != -1 && m_markdownRevision == revision;
+}
+
+void UserData::invalidateMarkdown()
+{
+    m_markdown = QString();
+    m_markdownRevision = -1;
+}
+
+DocumentSegment* UserData::segment() const
+{
+    return m_segment;
+}
+
+void UserData::setSegment(DocumentSegment* segment)
+{
+    m_segment = segment;
+}
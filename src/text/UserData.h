@@ -2,8 +2,12 @@
 #define USERDATA_H
 
 #include <QTextBlockUserData>
+#include <QString>
+#include <QPointer>
 #include "../Range.h"
 
+class DocumentSegment;
+
 struct UserData : public QTextBlockUserData
 {
     public:
@@ -21,9 +25,29 @@ struct UserData : public QTextBlockUserData
         void clearCommentRanges();
         const QVector<Range<int>> comments() const;
 
+        //! Gets the markdown this block was last serialized to.
+        //! Only meaningful if hasMarkdown() returns true.
+        const QString& markdown() const;
+        //! Caches the markdown this block serializes to at the given
+        //! block revision.
+        void setMarkdown(const QString& markdown, int revision);
+        //! Returns true if there is cached markdown for the given block
+        //! revision that has not been invalidated since.
+        bool hasMarkdown(int revision) const;
+        //! Discards the cached markdown.
+        void invalidateMarkdown();
+
+        //! Gets the DocumentSegment the block belongs to, if it was tagged
+        //! with one that still exists.
+        DocumentSegment* segment() const;
+        void setSegment(DocumentSegment* segment);
+
     private:
         int m_wordCount;
         QVector<Range<int>> m_comments;
+        QString m_markdown;
+        int m_markdownRevision;
+        QPointer<DocumentSegment> m_segment;
 };
 
 #endif // USERDATA_H
@@ -0,0 +1,71 @@
+#include <QTextBlock>
+
+#include "WordCountIndex.h"
+#include "UserData.h"
+
+WordCountIndex::WordCountIndex() : m_wordCounts()
+{
+}
+
+void WordCountIndex::reset(const QTextDocument* document)
+{
+    QVector<int> wordCounts;
+
+    if (document) {
+        wordCounts.reserve(document->blockCount());
+
+        for (QTextBlock block = document->begin(); block.isValid(); block = block.next()) {
+            const UserData* userData = dynamic_cast<const UserData*>(block.userData());
+            wordCounts.append(userData ? userData->wordCount() : 0);
+        }
+    }
+
+    m_wordCounts.reset(wordCounts);
+}
+
+void WordCountIndex::clear()
+{
+    m_wordCounts.clear();
+}
+
+int WordCountIndex::size() const
+{
+    return m_wordCounts.size();
+}
+
+int WordCountIndex::wordCount(int blockNumber) const
+{
+    return m_wordCounts.value(blockNumber);
+}
+
+void WordCountIndex::setWordCount(int blockNumber, int wordCount)
+{
+    m_wordCounts.setValue(blockNumber, wordCount);
+}
+
+void WordCountIndex::insertBlocks(int blockNumber, int count)
+{
+    if (count > 0) {
+        m_wordCounts.insert(blockNumber, QVector<int>(count, 0));
+    }
+}
+
+void WordCountIndex::removeBlocks(int blockNumber, int count)
+{
+    m_wordCounts.remove(blockNumber, count);
+}
+
+int WordCountIndex::wordCount(int from, int until) const
+{
+    return m_wordCounts.sum(from, until);
+}
+
+int WordCountIndex::wordsBefore(int blockNumber) const
+{
+    return m_wordCounts.sumBefore(blockNumber);
+}
+
+int WordCountIndex::total() const
+{
+    return m_wordCounts.total();
+}
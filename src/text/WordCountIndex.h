@@ -0,0 +1,49 @@
+#ifndef WORDCOUNTINDEX_H
+#define WORDCOUNTINDEX_H
+
+#include <QTextDocument>
+
+#include "PrefixSums.h"
+
+//! Keeps prefix sums over the word counts of all blocks of a document,
+//! keyed by block number, so that the number of words in any range of
+//! blocks can be determined without walking the blocks.
+class WordCountIndex
+{
+    public:
+        WordCountIndex();
+
+        //! Rebuilds the index from the word counts stored in the UserData of
+        //! all blocks of the document. This takes linear time.
+        void reset(const QTextDocument* document);
+        void clear();
+
+        //! Gets the number of blocks in the index.
+        int size() const;
+
+        //! Gets the word count of the block with the specified number.
+        int wordCount(int blockNumber) const;
+        //! Sets the word count of the block with the specified number.
+        void setWordCount(int blockNumber, int wordCount);
+        //! Inserts count blocks without any words before the block with the
+        //! specified number, which shifts the numbers of all following
+        //! blocks.
+        void insertBlocks(int blockNumber, int count);
+        //! Removes count blocks beginning at the block with the specified
+        //! number.
+        void removeBlocks(int blockNumber, int count);
+
+        //! Gets the number of words in all blocks from the block number
+        //! from (inclusive) until the block number until (exclusive).
+        int wordCount(int from, int until) const;
+        //! Gets the number of words in all blocks before the block with the
+        //! specified number.
+        int wordsBefore(int blockNumber) const;
+        //! Gets the number of words in all blocks.
+        int total() const;
+
+    private:
+        PrefixSums m_wordCounts;
+};
+
+#endif // WORDCOUNTINDEX_H
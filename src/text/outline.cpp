@@ -0,0 +1,81 @@
+#include <QTextBlock>
+
+#include "outline.h"
+
+QVector<outline::Entry> outline::entries(const QTextDocument* document)
+{
+    return entries(document, { 0, 1 }, [](const Entry&) { return false; });
+}
+
+QVector<outline::Entry> outline::entries(const QTextDocument* document, const Entry& first, const std::function<bool(const Entry&)>& stop)
+{
+    QVector<Entry> entries { first };
+
+    QTextBlock previous = QTextBlock();
+    QTextBlock previousHeading = QTextBlock();
+    QTextBlock block = document->findBlock(first.position);
+
+    if (first.position > 0) {
+        // Picks up where dividing the whole document would be right after
+        // the heading of the first entry.
+        previous = block;
+        previousHeading = block;
+        block = block.next();
+    }
+
+    while (block.isValid()) {
+        bool isHeading = block.blockFormat().headingLevel() > 0;
+        bool isSubheading = previous.blockFormat().headingLevel() == block.blockFormat().headingLevel() - 1
+                            // uneven headings are considered subheadings
+                            && block.blockFormat().headingLevel() % 2 == 0;
+
+        if (isHeading && !isSubheading) {
+            if (previous.isValid()) {
+                int depth;
+                const int previousDepth = entries.last().depth;
+                const int headingDifference = block.blockFormat().headingLevel() - previousHeading.blockFormat().headingLevel();
+
+                if (!previousHeading.isValid()) {
+                    depth = previousDepth;
+                } else {
+                    depth = previousDepth + headingDifference;
+                }
+
+                const Entry entry { block.position(), depth };
+
+                if (stop(entry)) {
+                    break;
+                }
+
+                entries.append(entry);
+            }
+
+            previousHeading = block;
+        }
+
+        previous = block;
+        block = block.next();
+    }
+
+    return entries;
+}
+
+QString outline::heading(const QTextBlock& first)
+{
+    if (first.blockFormat().headingLevel() == 0) {
+        return QString();
+    }
+
+    return first.text();
+}
+
+QString outline::subheading(const QTextBlock& first)
+{
+    const QTextBlock block = first.next();
+
+    if (block.blockFormat().headingLevel() == 0 || block.blockFormat().headingLevel() % 2 != 0) {
+        return QString();
+    }
+
+    return block.text();
+}
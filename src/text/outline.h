@@ -0,0 +1,40 @@
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include <QTextBlock>
+#include <QTextDocument>
+#include <QVector>
+#include <functional>
+
+//! Determines how a document is divided into DocumentSegments. This is kept
+//! separate from FormattableTextArea so that documents that are not shown in
+//! a text area (e.g. in the command-line tool) are divided the same way.
+namespace outline
+{
+    //! The start of a DocumentSegment.
+    struct Entry {
+        int position;
+        int depth;
+    };
+
+    //! Divides the document into segments at its headings. The first entry
+    //! always begins at position 0 with depth 1. A heading immediately
+    //! followed by a heading one level lower with an even level is treated
+    //! as heading and subheading of the same segment.
+    QVector<Entry> entries(const QTextDocument* document);
+    //! Divides the document the same way as entries(), but starts at the
+    //! given entry instead of the beginning of the document. Unless the entry
+    //! begins at position 0, its first block must be the heading it was
+    //! determined from. Stops before the first entry for which stop returns
+    //! true, so that only part of the document needs to be looked at.
+    QVector<Entry> entries(const QTextDocument* document, const Entry& first, const std::function<bool(const Entry&)>& stop);
+    //! Gets the heading of the segment beginning at the given block, or an
+    //! empty string if the block isn't a heading (only possible for the
+    //! first segment).
+    QString heading(const QTextBlock& first);
+    //! Gets the subheading of the segment beginning at the given block, or
+    //! an empty string if the heading isn't followed by a subheading.
+    QString subheading(const QTextBlock& first);
+}
+
+#endif // OUTLINE_H
@@ -0,0 +1,55 @@
+#include <algorithm>
+
+#include "searchresults.h"
+
+namespace {
+    bool startsBefore(const Range<int>& range, const int position)
+    {
+        return range.from() < position;
+    }
+}
+
+QVector<Range<int>> searchresults::splice(const QVector<Range<int>>& results, const int from, const int until, const int offset, const QVector<Range<int>>& matches)
+{
+    // The results are still where they were before the edit, so the end of
+    // the replaced results is where until was before the edit.
+    const auto replacedBegin = std::lower_bound(results.constBegin(), results.constEnd(), from, startsBefore);
+    const auto replacedEnd = std::lower_bound(replacedBegin, results.constEnd(), until - offset, startsBefore);
+
+    QVector<Range<int>> spliced;
+    spliced.reserve(results.size() - (replacedEnd - replacedBegin) + matches.size());
+
+    for (auto it = results.constBegin(); it != replacedBegin; it++) {
+        spliced.append(*it);
+    }
+
+    spliced.append(matches);
+
+    for (auto it = replacedEnd; it != results.constEnd(); it++) {
+        spliced.append(*it + offset);
+    }
+
+    return spliced;
+}
+
+QVector<Range<int>> searchresults::map(const QVector<Range<int>>& matches, const Range<int>& edited, const int offset)
+{
+    if (!edited.isValid()) {
+        return matches;
+    }
+
+    // Where the edited range ended in the copy of the text.
+    const int editedUntil = edited.until() - offset;
+    QVector<Range<int>> results;
+    results.reserve(matches.size());
+
+    for (const Range<int>& match : matches) {
+        if (match.until() <= edited.from()) {
+            results.append(match);
+        } else if (match.from() >= editedUntil) {
+            results.append(match + offset);
+        }
+    }
+
+    return results;
+}
@@ -0,0 +1,29 @@
+#ifndef SEARCHRESULTS_H
+#define SEARCHRESULTS_H
+
+#include <QVector>
+
+#include "../Range.h"
+
+//! Keeps the matches of a search, which are sorted by position, in step with
+//! edits of the document, so that only the edited text needs to be searched
+//! again. Matches never span multiple blocks, so the edited text is always
+//! extended to the blocks that contain it.
+namespace searchresults
+{
+    //! Replaces the results that lie between from (inclusive) and until
+    //! (exclusive) by the matches that were found there after an edit. Both
+    //! positions refer to the edited text. The text before from is unchanged
+    //! and the text from until on moved by offset, so the results following
+    //! the replaced ones are moved by offset as well.
+    QVector<Range<int>> splice(const QVector<Range<int>>& results, int from, int until, int offset, const QVector<Range<int>>& matches);
+    //! Moves matches found in an older copy of the text to where they are in
+    //! the current text. edited is the range of the current text that was
+    //! edited since the copy was made and offset the number of characters
+    //! it grew by. Matches that overlap the edited range are dropped since
+    //! that range has to be searched again anyway. If edited is invalid, the
+    //! matches are returned unchanged.
+    QVector<Range<int>> map(const QVector<Range<int>>& matches, const Range<int>& edited, int offset);
+}
+
+#endif // SEARCHRESULTS_H
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <QtAlgorithms>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "wordcount.h"
+#include "symbols.h"
+#include "UserData.h"
+
+namespace {
+    enum CharacterClass : quint8 {
+        //! Neither a separator nor part of a word (e.g. punctuation).
+        Other,
+        //! Always separates words (symbols::word_separators).
+        Separator,
+        //! Separates words only if repeated (symbols::word_separators_multiple).
+        RepeatedSeparator,
+        //! A letter or number, i.e. something that makes up a word.
+        WordCharacter,
+        //! A character that is a word on its own (e.g. a Chinese character).
+        Ideograph
+    };
+
+    //! Checks if the character is a CJK ideograph or Japanese kana. Only
+    //! characters in the Basic Multilingual Plane are recognized.
+    inline bool isIdeograph(ushort character)
+    {
+        return (character >= 0x3040 && character <= 0x30FF)    // Hiragana and Katakana
+            || (character >= 0x3400 && character <= 0x4DBF)    // CJK Unified Ideographs Extension A
+            || (character >= 0x4E00 && character <= 0x9FFF)    // CJK Unified Ideographs
+            || (character >= 0xF900 && character <= 0xFAFF);   // CJK Compatibility Ideographs
+    }
+
+    //! The rules TextIterator applies when iterating by word, as defined by
+    //! the sets in symbols.h.
+    struct StandardRules
+    {
+        static CharacterClass classify(QChar character)
+        {
+            if (symbols::word_separators.contains(character)) {
+                return Separator;
+            }
+
+            if (symbols::word_separators_multiple.contains(character)) {
+                return RepeatedSeparator;
+            }
+
+            return character.isLetterOrNumber() ? WordCharacter : Other;
+        }
+
+        //! Classifies characters outside of Latin-1 that are not in any of
+        //! the sets in symbols.h.
+        static inline CharacterClass classifyWide(ushort character)
+        {
+            return QChar::isLetterOrNumber(character) ? WordCharacter : Other;
+        }
+    };
+
+    //! Counts every CJK character as a word and separates words on the
+    //! ideographic space, since these scripts don't separate words by spaces.
+    struct IdeographicRules
+    {
+        static CharacterClass classify(QChar character)
+        {
+            const CharacterClass standard = StandardRules::classify(character);
+
+            if (standard == Separator || standard == RepeatedSeparator || character.unicode() < 256) {
+                return standard;
+            }
+
+            return classifyWide(character.unicode());
+        }
+
+        static inline CharacterClass classifyWide(ushort character)
+        {
+            // Excludes punctuation within the ranges, like the katakana middle dot.
+            if (isIdeograph(character) && QChar::isLetterOrNumber(character)) {
+                return Ideograph;
+            }
+
+            if (character == 0x3000) {
+                return Separator;
+            }
+
+            return StandardRules::classifyWide(character);
+        }
+    };
+
+    //! Counts each part of a hyphenated compound as a separate word.
+    struct SplitCompoundRules
+    {
+        static CharacterClass classify(QChar character)
+        {
+            return character == symbols::hyphen ? Separator : StandardRules::classify(character);
+        }
+
+        static inline CharacterClass classifyWide(ushort character)
+        {
+            return StandardRules::classifyWide(character);
+        }
+    };
+
+    //! Counts the parts before and after an apostrophe as separate words.
+    struct SplitApostropheRules
+    {
+        static CharacterClass classify(QChar character)
+        {
+            return symbols::isApostrophe(character) ? Separator : StandardRules::classify(character);
+        }
+
+        static inline CharacterClass classifyWide(ushort character)
+        {
+            return StandardRules::classifyWide(character);
+        }
+    };
+
+    //! Classifies characters according to the Rules. Latin-1 characters are
+    //! looked up in a table. All other characters are checked against the
+    //! few separators outside of Latin-1 before falling back to
+    //! Rules::classifyWide().
+    template<typename Rules>
+    class Classifier
+    {
+        public:
+            Classifier()
+            {
+                for (int i = 0; i < 256; i++) {
+                    m_latin1[i] = Rules::classify(QChar(ushort(i)));
+                }
+
+                for (const QSet<QChar>& separators : { symbols::word_separators, symbols::word_separators_multiple }) {
+                    for (const QChar& character : separators) {
+                        if (character.unicode() >= 256) {
+                            m_exceptions.append({ character.unicode(), Rules::classify(character) });
+                        }
+                    }
+                }
+            }
+
+            inline CharacterClass operator()(ushort character) const
+            {
+                if (character < 256) {
+                    return m_latin1[character];
+                }
+
+                for (const auto& exception : m_exceptions) {
+                    if (exception.first == character) {
+                        return exception.second;
+                    }
+                }
+
+                return Rules::classifyWide(character);
+            }
+
+        private:
+            CharacterClass m_latin1[256];
+            QVector<QPair<ushort, CharacterClass>> m_exceptions;
+    };
+
+    template<typename Rules>
+    const Classifier<Rules>& classifier()
+    {
+        static const Classifier<Rules> instance;
+
+        return instance;
+    }
+
+#if defined(__AVX2__)
+    //! Compares 16 characters at a time. Returns true if a character that
+    //! is not an ASCII letter or digit was found, in which case i is its
+    //! index. Otherwise, i is the index of the first character that was not
+    //! compared because fewer than 16 were left.
+    inline bool skipAsciiAlphanumerics16(const ushort* text, int& i, int until)
+    {
+        const __m256i caseBit = _mm256_set1_epi16(0x20);
+        const __m256i lowerA = _mm256_set1_epi16('a');
+        const __m256i zero = _mm256_set1_epi16('0');
+        const __m256i letterSpan = _mm256_set1_epi16(25);
+        const __m256i digitSpan = _mm256_set1_epi16(9);
+
+        for (; i + 16 <= until; i += 16) {
+            const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+            // (c | 0x20) - 'a' <= 25 (unsigned) for letters, c - '0' <= 9 for digits.
+            const __m256i letter = _mm256_sub_epi16(_mm256_or_si256(chunk, caseBit), lowerA);
+            const __m256i digit = _mm256_sub_epi16(chunk, zero);
+            const __m256i isLetter = _mm256_cmpeq_epi16(_mm256_subs_epu16(letter, letterSpan), _mm256_setzero_si256());
+            const __m256i isDigit = _mm256_cmpeq_epi16(_mm256_subs_epu16(digit, digitSpan), _mm256_setzero_si256());
+            const quint32 mask = ~quint32(_mm256_movemask_epi8(_mm256_or_si256(isLetter, isDigit)));
+
+            if (mask != 0) {
+                // Every character sets two bits in the mask.
+                i += qCountTrailingZeroBits(mask) / 2;
+                return true;
+            }
+        }
+
+        return false;
+    }
+#endif
+
+#if defined(__SSE2__)
+    //! Same as skipAsciiAlphanumerics16(), but compares 8 characters at a time.
+    inline bool skipAsciiAlphanumerics8(const ushort* text, int& i, int until)
+    {
+        const __m128i caseBit = _mm_set1_epi16(0x20);
+        const __m128i lowerA = _mm_set1_epi16('a');
+        const __m128i zero = _mm_set1_epi16('0');
+        const __m128i letterSpan = _mm_set1_epi16(25);
+        const __m128i digitSpan = _mm_set1_epi16(9);
+
+        for (; i + 8 <= until; i += 8) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            const __m128i letter = _mm_sub_epi16(_mm_or_si128(chunk, caseBit), lowerA);
+            const __m128i digit = _mm_sub_epi16(chunk, zero);
+            const __m128i isLetter = _mm_cmpeq_epi16(_mm_subs_epu16(letter, letterSpan), _mm_setzero_si128());
+            const __m128i isDigit = _mm_cmpeq_epi16(_mm_subs_epu16(digit, digitSpan), _mm_setzero_si128());
+            const quint32 mask = ~quint32(_mm_movemask_epi8(_mm_or_si128(isLetter, isDigit))) & 0xFFFF;
+
+            if (mask != 0) {
+                i += qCountTrailingZeroBits(mask) / 2;
+                return true;
+            }
+        }
+
+        return false;
+    }
+#endif
+
+    //! Returns the index of the first character at or after from that is
+    //! not an ASCII letter or digit, or until if there is none. Most of the
+    //! text in a manuscript consists of such runs, which are part of a word
+    //! under all rules, so they are skipped several characters at a time.
+    int skipAsciiAlphanumerics(const ushort* text, int from, int until)
+    {
+        int i = from;
+
+#if defined(__AVX2__)
+        if (skipAsciiAlphanumerics16(text, i, until)) {
+            return i;
+        }
+#endif
+
+#if defined(__SSE2__)
+        if (skipAsciiAlphanumerics8(text, i, until)) {
+            return i;
+        }
+#endif
+
+        for (; i < until; i++) {
+            const ushort character = text[i];
+            const ushort lower = character | 0x20;
+
+            if (!((lower >= 'a' && lower <= 'z') || (character >= '0' && character <= '9'))) {
+                return i;
+            }
+        }
+
+        return until;
+    }
+
+    bool isSorted(const QVector<Range<int>>& ranges)
+    {
+        return std::is_sorted(ranges.cbegin(), ranges.cend(), [](const Range<int>& a, const Range<int>& b) {
+            return a.from() < b.from();
+        });
+    }
+}
+
+namespace {
+    //! Counts the words in the text under the Rules. Each set of rules gets
+    //! its own copy of this loop, so that the classification of characters
+    //! is inlined into it.
+    template<typename Rules>
+    int countWith(const ushort* const data, const int length, const QVector<Range<int>>& sortedComments)
+    {
+        const Classifier<Rules>& classify = classifier<Rules>();
+        int words = 0;
+        bool inWord = false;
+        int comment = 0;
+        const int commentCount = sortedComments.size();
+
+        for (int i = 0; i < length; i++) {
+            // Ranges that end before this character can never contain any
+            // of the following characters either.
+            while (comment < commentCount && sortedComments.at(comment).until() <= i) {
+                comment++;
+            }
+
+            if (comment < commentCount && sortedComments.at(comment).from() <= i) {
+                // Comments may overlap, so the range that ends last wins.
+                int until = sortedComments.at(comment).until();
+
+                for (int next = comment + 1; next < commentCount && sortedComments.at(next).from() <= i; next++) {
+                    until = qMax(until, sortedComments.at(next).until());
+                }
+
+                i = until - 1;
+                continue;
+            }
+
+            const int runEnd = skipAsciiAlphanumerics(data, i, comment < commentCount ? sortedComments.at(comment).from() : length);
+
+            if (runEnd > i) {
+                inWord = true;
+                i = runEnd - 1;
+                continue;
+            }
+
+            switch (classify(data[i])) {
+                case Separator:
+                    words += inWord;
+                    inWord = false;
+                    break;
+                case RepeatedSeparator:
+                    // Neighbours outside the text never count as repetitions.
+                    if ((i > 0 && data[i - 1] == data[i]) || (i + 1 < length && data[i + 1] == data[i])) {
+                        words += inWord;
+                        inWord = false;
+                    }
+                    break;
+                case WordCharacter:
+                    inWord = true;
+                    break;
+                case Ideograph:
+                    words += inWord + 1;
+                    inWord = false;
+                    break;
+                case Other:
+                    break;
+            }
+        }
+
+        return words + inWord;
+    }
+}
+
+int wordcount::count(const QChar* text, int length, const QVector<Range<int>>& comments, Rules rules)
+{
+    // TextFormatter adds comment ranges in order, so this copy is only made
+    // if the ranges come from somewhere else.
+    QVector<Range<int>> sortedComments = comments;
+
+    if (!isSorted(sortedComments)) {
+        std::sort(sortedComments.begin(), sortedComments.end(), [](const Range<int>& a, const Range<int>& b) {
+            return a.from() < b.from();
+        });
+    }
+
+    const ushort* const data = reinterpret_cast<const ushort*>(text);
+
+    switch (rules) {
+        case Rules::Ideographic:
+            return countWith<IdeographicRules>(data, length, sortedComments);
+        case Rules::SplitCompounds:
+            return countWith<SplitCompoundRules>(data, length, sortedComments);
+        case Rules::SplitApostrophes:
+            return countWith<SplitApostropheRules>(data, length, sortedComments);
+        case Rules::Standard:
+        default:
+            return countWith<StandardRules>(data, length, sortedComments);
+    }
+}
+
+int wordcount::count(const QString& text, const QVector<Range<int>>& comments, Rules rules)
+{
+    return count(text.constData(), text.size(), comments, rules);
+}
+
+int wordcount::count(const QTextBlock& block, Rules rules)
+{
+    const UserData* userData = dynamic_cast<const UserData*>(block.userData());
+    const QString text = block.text();
+
+    return count(text.constData(), text.size(), userData ? userData->comments() : QVector<Range<int>>(), rules);
+}
+
+int wordcount::count(const QTextBlock& block, int from, int until, Rules rules)
+{
+    const UserData* userData = dynamic_cast<const UserData*>(block.userData());
+    const QString text = block.text();
+
+    from = qBound(0, from, text.size());
+    until = qBound(from, until, text.size());
+
+    QVector<Range<int>> comments;
+
+    if (userData) {
+        for (const Range<int>& comment : userData->comments()) {
+            if (comment.intersects(from, until)) {
+                comments.append(comment - from);
+            }
+        }
+    }
+
+    return count(text.constData() + from, until - from, comments, rules);
+}
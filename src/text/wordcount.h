@@ -0,0 +1,55 @@
+#ifndef WORDCOUNT_H
+#define WORDCOUNT_H
+
+#include <QString>
+#include <QTextBlock>
+#include <QVector>
+
+#include "../Range.h"
+
+//! Counts words directly on block texts. The rules are the same ones
+//! TextIterator applies when iterating by word, but the text does not need
+//! to be selected with a QTextCursor first, and each character is only
+//! looked at once.
+namespace wordcount
+{
+    //! Determines what counts as a word.
+    enum class Rules {
+        //! The rules TextIterator applies.
+        Standard,
+        //! Like Standard, but every Chinese or Japanese character counts as
+        //! a word of its own.
+        Ideographic,
+        //! Like Standard, but single hyphens separate words, so that each
+        //! part of a hyphenated compound is counted.
+        SplitCompounds,
+        //! Like Standard, but apostrophes separate words, so that elisions
+        //! like the French "l'homme" count as two words.
+        SplitApostrophes
+    };
+
+    //! Counts the words in the text. Characters inside any of the comment
+    //! ranges (which are relative to the start of the text) are skipped as
+    //! if they weren't there.
+    int count(const QChar* text, int length, const QVector<Range<int>>& comments = {}, Rules rules = Rules::Standard);
+    int count(const QString& text, const QVector<Range<int>>& comments = {}, Rules rules = Rules::Standard);
+    //! Counts the words in the block, skipping the comment ranges stored in
+    //! its UserData.
+    int count(const QTextBlock& block, Rules rules = Rules::Standard);
+    //! Counts the words between from (inclusive) and until (exclusive),
+    //! which are positions relative to the start of the block. Words cut off
+    //! by either end are counted as if the text ended there.
+    int count(const QTextBlock& block, int from, int until, Rules rules = Rules::Standard);
+
+    //! The number of words on a standard manuscript page.
+    constexpr int WORDS_PER_PAGE = 250;
+
+    //! Gets the number of manuscript pages the words fill, counting a
+    //! partially filled page as a full one.
+    constexpr int pageCount(const int words)
+    {
+        return words / WORDS_PER_PAGE + (words % WORDS_PER_PAGE != 0 ? 1 : 0);
+    }
+}
+
+#endif // WORDCOUNT_H
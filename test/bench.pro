@@ -0,0 +1,44 @@
+QT += quick quickcontrols2 quick-private concurrent
+
+CONFIG += c++20 console release
+CONFIG -= app_bundle
+
+TARGET = bench
+
+#Application version
+VERSION_MAJOR = 0
+VERSION_MINOR = 0
+VERSION_BUILD = 1
+
+DEFINES += "VERSION_MAJOR=$$VERSION_MAJOR"\
+       "VERSION_MINOR=$$VERSION_MINOR"\
+       "VERSION_BUILD=$$VERSION_BUILD"
+
+#Target version
+VERSION = $${VERSION_MAJOR}.$${VERSION_MINOR}.$${VERSION_BUILD}
+
+DEFINES += QT_DEPRECATED_WARNINGS \
+    QT_USE_QSTRINGBUILDER # redefines + into QStringBuilder's more efficient %
+
+HEADERS += \
+        $$files(../src/*.h, true) \
+        ../libs/md4c/src/md4c.h \
+        bench/benchmark.h \
+        bench/manuscript.h
+
+SOURCES += \
+        $$files(../src/*.cpp, true) \
+        ../libs/md4c/src/md4c.c \
+        bench/benchmark.cpp \
+        bench/manuscript.cpp \
+        bench/main.cpp \
+        bench/bench_formattabletextarea.cpp \
+        bench/bench_markdownparser.cpp \
+        bench/bench_stringreplacer.cpp \
+        bench/bench_textformatter.cpp \
+        bench/bench_wordcount.cpp
+SOURCES -= ../src/main.cpp
+
+INCLUDEPATH += ../src
+INCLUDEPATH += ../libs
+DEPENDPATH += ../src
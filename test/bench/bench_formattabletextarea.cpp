@@ -0,0 +1,137 @@
+#include <QEventLoop>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include "benchmark.h"
+#include "manuscript.h"
+#include "text/FormattableTextArea/FormattableTextArea.h"
+
+namespace {
+    //! Writes a generated manuscript into the directory and returns its URL.
+    QUrl writeManuscript(const QTemporaryDir& directory, int words)
+    {
+        const QString fileName = directory.filePath(QString::number(words) + ".md");
+        QFile file(fileName);
+
+        if (file.open(QFile::WriteOnly | QFile::Truncate)) {
+            file.write(manuscript::generate(words, benchmark::options().markupDensity).toUtf8());
+        }
+
+        return QUrl::fromLocalFile(fileName);
+    }
+
+    //! Loads the file and waits until the document has been swapped in,
+    //! i.e. until the document can be edited.
+    void load(FormattableTextArea& textArea, const QUrl& fileUrl)
+    {
+        QEventLoop loop;
+        QObject::connect(&textArea, &FormattableTextArea::loaded, &loop, &QEventLoop::quit);
+        textArea.load(fileUrl);
+        loop.exec();
+    }
+
+    //! Waits until the words of the document have been counted.
+    void waitForWordCount(FormattableTextArea& textArea)
+    {
+        if (!textArea.countingWords()) {
+            return;
+        }
+
+        QEventLoop loop;
+        QObject::connect(&textArea, &FormattableTextArea::countingWordsChanged, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+
+    //! Loads the file and parses the parts of large files that would
+    //! otherwise be appended in the background.
+    void loadCompletely(FormattableTextArea& textArea, const QUrl& fileUrl)
+    {
+        load(textArea, fileUrl);
+        textArea.selectAll();
+        textArea.setCaretPosition(0);
+    }
+}
+
+BENCHMARK(FormattableTextArea, load) {
+    QTemporaryDir directory;
+
+    for (const int size : benchmark::options().sizes) {
+        const QUrl fileUrl = writeManuscript(directory, size);
+        FormattableTextArea textArea;
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            textArea.reset();
+        }, [&] {
+            load(textArea, fileUrl);
+        });
+    }
+}
+
+BENCHMARK(FormattableTextArea, countWords) {
+    // countWords() is private, but changing the word count rules recounts
+    // every block of the document, in the background for large documents.
+    QTemporaryDir directory;
+
+    for (const int size : benchmark::options().sizes) {
+        FormattableTextArea textArea;
+        loadCompletely(textArea, writeManuscript(directory, size));
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            textArea.setWordCountRules(FormattableTextArea::WordCountRules::Standard);
+            waitForWordCount(textArea);
+        }, [&] {
+            textArea.setWordCountRules(FormattableTextArea::WordCountRules::SplitCompounds);
+            waitForWordCount(textArea);
+        });
+    }
+}
+
+BENCHMARK(FormattableTextArea, refreshDocumentStructure) {
+    // Removing the paragraph break in front of a heading turns the heading
+    // into a regular paragraph, which removes its segment from the structure.
+    QTemporaryDir directory;
+
+    for (const int size : benchmark::options().sizes) {
+        FormattableTextArea textArea;
+        loadCompletely(textArea, writeManuscript(directory, size));
+
+        if (textArea.documentStructure().size() < 2) {
+            continue;
+        }
+
+        const int headingPosition = textArea.documentStructure().at(1)->position();
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            if (textArea.canUndo()) {
+                textArea.undo();
+            }
+
+            textArea.setCaretPosition(headingPosition - 1);
+            textArea.moveCursor(QTextCursor::Right, QTextCursor::KeepAnchor);
+        }, [&] {
+            textArea.remove();
+        });
+    }
+}
+
+BENCHMARK(FormattableTextArea, find) {
+    QTemporaryDir directory;
+
+    for (const int size : benchmark::options().sizes) {
+        FormattableTextArea textArea;
+        loadCompletely(textArea, writeManuscript(directory, size));
+
+        state.measure(benchmark::sizeLabel(size) + ", literal", [&] {
+            textArea.clearMatches();
+        }, [&] {
+            textArea.find("the");
+        });
+
+        state.measure(benchmark::sizeLabel(size) + ", regex", [&] {
+            textArea.clearMatches();
+        }, [&] {
+            textArea.find("\\bw\\w+", FormattableTextArea::SearchOption::RegEx);
+        });
+    }
+}
@@ -0,0 +1,103 @@
+#include <QTextDocument>
+#include <QTextCursor>
+#include <QTextStream>
+
+#include "benchmark.h"
+#include "manuscript.h"
+#include "text/MarkdownParser.h"
+
+BENCHMARK(MarkdownParser, parse) {
+    for (const int size : benchmark::options().sizes) {
+        const QString markdown = manuscript::generate(size, benchmark::options().markupDensity);
+        QTextDocument* document = nullptr;
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            delete document;
+            document = new QTextDocument();
+        }, [&] {
+            MarkdownParser(document).parse(markdown);
+        });
+
+        delete document;
+    }
+}
+
+BENCHMARK(MarkdownParser, parseUtf8) {
+    for (const int size : benchmark::options().sizes) {
+        const QByteArray markdown = manuscript::generate(size, benchmark::options().markupDensity).toUtf8();
+        QTextDocument* document = nullptr;
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            delete document;
+            document = new QTextDocument();
+        }, [&] {
+            MarkdownParser(document).parse(markdown.constData(), markdown.size());
+        });
+
+        delete document;
+    }
+}
+
+BENCHMARK(MarkdownParser, write) {
+    for (const int size : benchmark::options().sizes) {
+        QTextDocument document;
+        MarkdownParser(&document).parse(manuscript::generate(size, benchmark::options().markupDensity));
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            // Cached markdown would otherwise make every iteration after
+            // the first one measure the incremental path.
+            MarkdownParser::invalidate(&document, 0, document.characterCount());
+        }, [&] {
+            QString output;
+            QTextStream stream(&output);
+            MarkdownParser(&document).write(stream);
+            stream.flush();
+        });
+    }
+}
+
+BENCHMARK(MarkdownParser, writeAfterEdit) {
+    for (const int size : benchmark::options().sizes) {
+        QTextDocument document;
+        MarkdownParser(&document).parse(manuscript::generate(size, benchmark::options().markupDensity));
+
+        QString warmup;
+        QTextStream warmupStream(&warmup);
+        MarkdownParser(&document).write(warmupStream);
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            QTextCursor cursor(&document);
+            cursor.setPosition(document.characterCount() / 2);
+            cursor.insertText(QStringLiteral("word "));
+            MarkdownParser::invalidate(&document, cursor.position() - 5, 5);
+        }, [&] {
+            QString output;
+            QTextStream stream(&output);
+            MarkdownParser(&document).write(stream);
+            stream.flush();
+        });
+    }
+}
+
+BENCHMARK(MarkdownParser, writeByMarkupDensity) {
+    // Prose rarely needs escaping or emphasis marks, whereas markup-heavy
+    // text exercises the mark state for nearly every fragment.
+    const QVector<QPair<QString, double>> densities = {
+        { "prose", 0.0 },
+        { "markup-heavy", 0.5 }
+    };
+
+    for (const auto& density : densities) {
+        QTextDocument document;
+        MarkdownParser(&document).parse(manuscript::generate(100'000, density.second));
+
+        state.measure(density.first, [&] {
+            MarkdownParser::invalidate(&document, 0, document.characterCount());
+        }, [&] {
+            QString output;
+            QTextStream stream(&output);
+            MarkdownParser(&document).write(stream);
+            stream.flush();
+        });
+    }
+}
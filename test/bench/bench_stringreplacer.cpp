@@ -0,0 +1,24 @@
+#include "benchmark.h"
+#include "manuscript.h"
+#include "text/StringReplacer.h"
+
+BENCHMARK(StringReplacer, replace) {
+    // Mirrors how the text area calls the replacer: once per typed
+    // character, with the preceding character as context.
+    StringReplacer replacer;
+    replacer.setSmartReplacement(QChar('"'), QChar(0x201C), QChar(0x201D));
+    replacer.setSmartReplacement(QChar('\''), QChar(0x2018), QChar(0x2019));
+
+    for (const int size : benchmark::options().sizes) {
+        const QString text = manuscript::generate(size, benchmark::options().markupDensity);
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            QString before;
+
+            for (const QChar& character : text) {
+                const QString typed(character);
+                before = replacer.replace(typed, before);
+            }
+        });
+    }
+}
@@ -0,0 +1,18 @@
+#include <QTextDocument>
+
+#include "benchmark.h"
+#include "manuscript.h"
+#include "text/MarkdownParser.h"
+#include "text/TextFormatter.h"
+
+BENCHMARK(TextFormatter, rehighlight) {
+    for (const int size : benchmark::options().sizes) {
+        QTextDocument document;
+        MarkdownParser(&document).parse(manuscript::generate(size, benchmark::options().markupDensity));
+        TextFormatter formatter(&document);
+
+        state.measure(benchmark::sizeLabel(size), [&] {
+            formatter.refresh();
+        });
+    }
+}
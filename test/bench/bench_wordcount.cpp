@@ -0,0 +1,83 @@
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+#include "benchmark.h"
+#include "manuscript.h"
+#include "text/MarkdownParser.h"
+#include "text/TextIterator.h"
+#include "text/wordcount.h"
+
+BENCHMARK(wordcount, document) {
+    for (const int size : benchmark::options().sizes) {
+        QTextDocument document;
+        MarkdownParser(&document).parse(manuscript::generate(size, benchmark::options().markupDensity));
+
+        // The per-block cursor and TextIterator that countWords() used
+        // before wordcount::count() existed, for comparison.
+        state.measure(benchmark::sizeLabel(size) + ", TextIterator", [&] {
+            for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+                QTextCursor cursor(block);
+                cursor.select(QTextCursor::SelectionType::BlockUnderCursor);
+                TextIterator iterator(cursor, TextIterator::IterationType::ByWord);
+
+                while (!iterator.atEnd()) {
+                    iterator++;
+                }
+            }
+        });
+
+        state.measure(benchmark::sizeLabel(size) + ", wordcount", [&] {
+            for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+                wordcount::count(block);
+            }
+        });
+    }
+}
+
+BENCHMARK(wordcount, kernel) {
+    // ASCII prose mostly takes the vectorized path for runs of letters,
+    // whereas Cyrillic prose is classified character by character.
+    for (const int size : benchmark::options().sizes) {
+        const QString latin = manuscript::generate(size, benchmark::options().markupDensity);
+        QString cyrillic = latin;
+
+        for (QChar& character : cyrillic) {
+            if (character >= 'a' && character <= 'z') {
+                character = QChar(0x0430 + (character.unicode() - 'a'));
+            }
+        }
+
+        state.measure(benchmark::sizeLabel(size) + ", latin", [&] {
+            wordcount::count(latin);
+        });
+
+        state.measure(benchmark::sizeLabel(size) + ", cyrillic", [&] {
+            wordcount::count(cyrillic);
+        });
+    }
+}
+
+BENCHMARK(wordcount, rules) {
+    // Every set of rules has its own counting loop, so choosing one must not
+    // make the others any slower.
+    for (const int size : benchmark::options().sizes) {
+        const QString text = manuscript::generate(size, benchmark::options().markupDensity);
+
+        state.measure(benchmark::sizeLabel(size) + ", standard", [&] {
+            wordcount::count(text, {}, wordcount::Rules::Standard);
+        });
+
+        state.measure(benchmark::sizeLabel(size) + ", ideographic", [&] {
+            wordcount::count(text, {}, wordcount::Rules::Ideographic);
+        });
+
+        state.measure(benchmark::sizeLabel(size) + ", split compounds", [&] {
+            wordcount::count(text, {}, wordcount::Rules::SplitCompounds);
+        });
+
+        state.measure(benchmark::sizeLabel(size) + ", split apostrophes", [&] {
+            wordcount::count(text, {}, wordcount::Rules::SplitApostrophes);
+        });
+    }
+}
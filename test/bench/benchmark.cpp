@@ -0,0 +1,228 @@
+#include <limits>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTextStream>
+
+#include "benchmark.h"
+
+namespace {
+    constexpr qint64 TARGET_NANOSECONDS = 500'000'000;
+    constexpr int MAXIMUM_ITERATIONS = 10;
+
+    struct Registration {
+        QString group;
+        QString name;
+        benchmark::Function function;
+    };
+
+    benchmark::Options& mutableOptions()
+    {
+        static benchmark::Options options;
+
+        return options;
+    }
+
+    QVector<Registration>& registry()
+    {
+        // Function-local static so registration from static initializers
+        // in other translation units is safe.
+        static QVector<Registration> registrations;
+
+        return registrations;
+    }
+
+    QString formatDuration(qint64 nanoseconds)
+    {
+        if (nanoseconds >= 1'000'000) {
+            return QString::number(nanoseconds / 1'000'000.0, 'f', 2) + " ms";
+        }
+
+        return QString::number(nanoseconds / 1'000.0, 'f', 2) + " us";
+    }
+
+    bool writeJson(const QString& fileName, const QVector<benchmark::Result>& results)
+    {
+        QJsonArray array;
+
+        for (const benchmark::Result& result : results) {
+            array.append(QJsonObject {
+                { "group", result.group },
+                { "name", result.name },
+                { "variant", result.variant },
+                { "iterations", result.iterations },
+                { "minimumNanoseconds", result.minimumNanoseconds },
+                { "meanNanoseconds", result.meanNanoseconds }
+            });
+        }
+
+        const benchmark::Options& options = benchmark::options();
+        QJsonArray sizes;
+
+        for (const int size : options.sizes) {
+            sizes.append(size);
+        }
+
+        const QJsonObject root {
+            { "cpu", QSysInfo::currentCpuArchitecture() },
+            { "os", QSysInfo::prettyProductName() },
+            { "qt", QString::fromLatin1(qVersion()) },
+            { "sizes", sizes },
+            { "markupDensity", options.markupDensity },
+            { "results", array }
+        };
+
+        QFile file(fileName);
+
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            return false;
+        }
+
+        return file.write(QJsonDocument(root).toJson()) != -1;
+    }
+}
+
+const benchmark::Options& benchmark::options()
+{
+    return mutableOptions();
+}
+
+bool benchmark::configure(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs the Skywriter benchmarks.");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "words", "Comma-separated sizes of the generated manuscripts in words.", "sizes" },
+        { "density", "Probability (0 to 1) that a word is wrapped in markup.", "density" },
+        { "filter", "Only runs benchmarks whose group.name contains this string.", "filter" },
+        { "json", "Writes the results as JSON to this file.", "file" }
+    });
+    parser.process(arguments);
+
+    Options& options = mutableOptions();
+
+    if (parser.isSet("words")) {
+        options.sizes.clear();
+
+        for (const QString& size : parser.value("words").split(',', Qt::SkipEmptyParts)) {
+            bool ok;
+            const int words = size.trimmed().toInt(&ok);
+
+            if (!ok || words <= 0) {
+                QTextStream(stderr) << "Invalid size: " << size << Qt::endl;
+                return false;
+            }
+
+            options.sizes.append(words);
+        }
+    }
+
+    if (parser.isSet("density")) {
+        bool ok;
+        options.markupDensity = parser.value("density").toDouble(&ok);
+
+        if (!ok || options.markupDensity < 0.0 || options.markupDensity > 1.0) {
+            QTextStream(stderr) << "Invalid markup density: " << parser.value("density") << Qt::endl;
+            return false;
+        }
+    }
+
+    options.filter = parser.value("filter");
+    options.jsonFile = parser.value("json");
+
+    return true;
+}
+
+QString benchmark::sizeLabel(int words)
+{
+    if (words >= 1'000'000 && words % 1'000'000 == 0) {
+        return QString::number(words / 1'000'000) + "M words";
+    }
+
+    if (words >= 1'000 && words % 1'000 == 0) {
+        return QString::number(words / 1'000) + "k words";
+    }
+
+    return QString::number(words) + " words";
+}
+
+benchmark::State::State(const QString& group, const QString& name) :
+    m_group(group),
+    m_name(name),
+    m_results()
+{ }
+
+void benchmark::State::measure(const QString& variant, const std::function<void()>& callback)
+{
+    measure(variant, [] {}, callback);
+}
+
+void benchmark::State::measure(const QString& variant, const std::function<void()>& setup, const std::function<void()>& callback)
+{
+    QElapsedTimer timer;
+    qint64 total = 0;
+    qint64 minimum = std::numeric_limits<qint64>::max();
+    int iterations = 0;
+
+    while (iterations < MAXIMUM_ITERATIONS && (iterations == 0 || total < TARGET_NANOSECONDS)) {
+        setup();
+        timer.start();
+        callback();
+        const qint64 elapsed = timer.nsecsElapsed();
+
+        total += elapsed;
+        minimum = qMin(minimum, elapsed);
+        iterations++;
+    }
+
+    m_results.append({ m_group, m_name, variant, iterations, minimum, total / iterations });
+}
+
+const QVector<benchmark::Result>& benchmark::State::results() const
+{
+    return m_results;
+}
+
+bool benchmark::add(const char* group, const char* name, Function function)
+{
+    registry().append({ QString::fromLatin1(group), QString::fromLatin1(name), function });
+
+    return true;
+}
+
+bool benchmark::runAll()
+{
+    QTextStream out(stdout);
+    QVector<Result> results;
+
+    for (const Registration& registration : registry()) {
+        if (!options().filter.isEmpty()
+         && !QString(registration.group + "." + registration.name).contains(options().filter)) {
+            continue;
+        }
+
+        State state(registration.group, registration.name);
+        registration.function(state);
+        results.append(state.results());
+
+        for (const Result& result : state.results()) {
+            out << result.group << "." << result.name << " [" << result.variant << "]: "
+                << formatDuration(result.minimumNanoseconds) << " min, "
+                << formatDuration(result.meanNanoseconds) << " mean ("
+                << result.iterations << " iterations)" << Qt::endl;
+        }
+    }
+
+    if (!options().jsonFile.isEmpty() && !writeJson(options().jsonFile, results)) {
+        QTextStream(stderr) << "Cannot write " << options().jsonFile << Qt::endl;
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,82 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <functional>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// A minimal benchmark harness. Benchmarks are registered with the BENCHMARK
+// macro (similar to gtest's TEST macro) and run by main.cpp in the order
+// they were registered.
+
+namespace benchmark {
+    //! The timings collected for a single benchmark variant.
+    struct Result {
+        QString group;
+        QString name;
+        QString variant;
+        int iterations;
+        qint64 minimumNanoseconds;
+        qint64 meanNanoseconds;
+    };
+
+    class State
+    {
+        public:
+            State(const QString& group, const QString& name);
+
+            //! Runs the callback repeatedly and records its timings under
+            //! the given variant (e.g. the input size). The callback is run
+            //! at least once and until about half a second has elapsed, but
+            //! no more than ten times.
+            void measure(const QString& variant, const std::function<void()>& callback);
+            //! Same as measure(), but runs setup before each iteration
+            //! without including it in the timings.
+            void measure(const QString& variant, const std::function<void()>& setup, const std::function<void()>& callback);
+
+            const QVector<Result>& results() const;
+
+        private:
+            QString m_group;
+            QString m_name;
+            QVector<Result> m_results;
+    };
+
+    //! Settings shared by all benchmarks, configurable from the command line.
+    struct Options {
+        //! The sizes (in words) of the generated manuscripts.
+        QVector<int> sizes { 10'000, 100'000, 1'000'000 };
+        //! See manuscript::generate().
+        double markupDensity = 0.05;
+        //! If not empty, only benchmarks whose "group.name" contains this
+        //! string are run.
+        QString filter;
+        //! If not empty, the results are also written to this file as JSON.
+        QString jsonFile;
+    };
+
+    const Options& options();
+    //! Parses the command line arguments into options(). Returns false if
+    //! the arguments are invalid, in which case the program should exit.
+    bool configure(const QStringList& arguments);
+    //! Returns a human-readable label for the given number of words, e.g.
+    //! "100k words".
+    QString sizeLabel(int words);
+
+    using Function = void (*)(State& state);
+
+    //! Registers a benchmark. Use the BENCHMARK macro instead.
+    bool add(const char* group, const char* name, Function function);
+    //! Runs all registered benchmarks that match the filter and prints their
+    //! results. Returns false if the results could not be written to the
+    //! JSON file.
+    bool runAll();
+}
+
+#define BENCHMARK(group, name) \
+    static void group##_##name(benchmark::State& state); \
+    static const bool group##_##name##_registered = benchmark::add(#group, #name, &group##_##name); \
+    static void group##_##name(benchmark::State& state)
+
+#endif // BENCHMARK_H
@@ -0,0 +1,21 @@
+#include <QGuiApplication>
+
+#include "benchmark.h"
+
+int main(int argc, char *argv[])
+{
+    // Benchmarks never show a window, so don't require a display.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QGuiApplication::setOrganizationName("cengels");
+    QGuiApplication::setApplicationName("Skywriter Benchmarks");
+    QGuiApplication app(argc, argv);
+
+    if (!benchmark::configure(app.arguments())) {
+        return 2;
+    }
+
+    return benchmark::runAll() ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+#include <QRandomGenerator>
+#include <QStringList>
+
+#include "manuscript.h"
+
+namespace {
+    constexpr int WORDS_PER_PARAGRAPH = 80;
+    constexpr int PARAGRAPHS_PER_SCENE = 12;
+    constexpr int WORDS_PER_CHAPTER = 5000;
+
+    const QStringList vocabulary = {
+        "the", "sky", "was", "grey", "and", "she", "walked", "along", "river's",
+        "edge", "without", "looking", "back", "at", "town", "where", "nobody",
+        "knew", "her", "name", "wind", "carried", "smell", "of", "rain", "half-forgotten",
+        "letters", "from", "a", "brother", "who", "had", "never", "written", "twice",
+        "“Wait,”", "he", "said.", "quietly", "—", "lantern", "glass", "shattered,",
+        // Escaped in the markdown, so that the parsed text contains marks that
+        // the writer has to escape again.
+        "snake\\_case", "5\\*3", "\\~forty", "and\\\\or", "so\\_very\\_long\\_that\\_it\\_spans\\_vectors"
+    };
+}
+
+QString manuscript::generate(int words, double markupDensity)
+{
+    // Fixed seed so that every run benchmarks the same input.
+    QRandomGenerator random(1337);
+    QString text;
+    text.reserve(words * 7);
+
+    int chapter = 0;
+    int wordsInChapter = WORDS_PER_CHAPTER;
+    int paragraphsInScene = 0;
+
+    for (int written = 0; written < words;) {
+        if (wordsInChapter >= WORDS_PER_CHAPTER) {
+            chapter++;
+            wordsInChapter = 0;
+            paragraphsInScene = 0;
+            text += QStringLiteral("# Chapter %1\n\n").arg(chapter);
+        } else if (paragraphsInScene >= PARAGRAPHS_PER_SCENE) {
+            paragraphsInScene = 0;
+            text += QStringLiteral("---\n\n");
+        }
+
+        const int paragraphWords = qMin(WORDS_PER_PARAGRAPH, words - written);
+
+        for (int i = 0; i < paragraphWords; i++) {
+            const QString& word = vocabulary.at(random.bounded(vocabulary.size()));
+
+            if (i > 0) {
+                text += ' ';
+            }
+
+            if (random.generateDouble() < markupDensity) {
+                switch (random.bounded(3)) {
+                    case 0: text += '*' + word + '*'; break;
+                    case 1: text += "**" + word + "**"; break;
+                    default: text += "~~" + word + "~~"; break;
+                }
+            } else {
+                text += word;
+            }
+        }
+
+        text += QStringLiteral("\n\n");
+        written += paragraphWords;
+        wordsInChapter += paragraphWords;
+        paragraphsInScene++;
+    }
+
+    return text;
+}
@@ -0,0 +1,17 @@
+#ifndef MANUSCRIPT_H
+#define MANUSCRIPT_H
+
+#include <QString>
+
+namespace manuscript {
+    //! Generates a deterministic markdown manuscript of roughly the given
+    //! number of words. The manuscript is divided into chapters (level 1
+    //! headings) of about 5000 words, which are in turn divided into scenes
+    //! separated by scene breaks.
+    //!
+    //! markupDensity is the probability (between 0 and 1) that any given
+    //! word is wrapped in emphasis, strong emphasis or strikethrough.
+    QString generate(int words, double markupDensity = 0.05);
+}
+
+#endif // MANUSCRIPT_H
@@ -39,7 +39,13 @@ SOURCES += \
         ../libs/gtest/googletest/src/gtest_main.cc \
         unit/FormattableTextArea/test_word_movement.cpp \
         unit/FormattableTextArea/test_word_selection.cpp \
-        unit/test_symbols.cpp
+        unit/test_markdownparser.cpp \
+        unit/test_outline.cpp \
+        unit/test_prefixsums.cpp \
+        unit/test_searchresults.cpp \
+        unit/test_symbols.cpp \
+        unit/test_wordcount.cpp \
+        unit/test_wordcountindex.cpp
 SOURCES -= ../src/main.cpp
 
 INCLUDEPATH += ../src
@@ -0,0 +1,249 @@
+#include <cstring>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+
+#include "gtest/gtest.h"
+#include "text/MarkdownParser.h"
+#include "text/format.h"
+#include "customqtprint.h"
+
+namespace {
+    QVector<qint64> headingOffsets(const char* markdown)
+    {
+        return MarkdownParser::headingOffsets(markdown, qint64(strlen(markdown)));
+    }
+
+    //! Block formats that don't depend on the active theme.
+    MarkdownParser::BlockFormats blockFormats()
+    {
+        MarkdownParser::BlockFormats formats;
+
+        for (int level = 1; level <= 6; level++) {
+            QTextBlockFormat heading;
+            heading.setHeadingLevel(level);
+            formats.headings.append(heading);
+        }
+
+        return formats;
+    }
+
+    QString write(QTextDocument& document)
+    {
+        QString markdown;
+        QTextStream stream(&markdown);
+        MarkdownParser(&document, blockFormats()).write(stream);
+        stream.flush();
+
+        return markdown;
+    }
+
+    //! Gets a character format from a combination of the tags b (bold),
+    //! i (italic) and s (strikethrough).
+    QTextCharFormat charFormat(const QString& tags)
+    {
+        QTextCharFormat format;
+        format.setFontWeight(tags.contains('b') ? QFont::Bold : QFont::Normal);
+        format.setFontItalic(tags.contains('i'));
+        format.setFontStrikeOut(tags.contains('s'));
+
+        return format;
+    }
+
+    //! Inserts a block made up of pairs of tags and text.
+    void insertBlock(QTextCursor& cursor, const QVector<QPair<QString, QString>>& runs)
+    {
+        if (!cursor.atStart()) {
+            cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+        }
+
+        for (const QPair<QString, QString>& run : runs) {
+            cursor.insertText(run.second, charFormat(run.first));
+        }
+    }
+
+    //! Describes the text and emphasis of all blocks, e.g. "<b>bold</b>".
+    //! Whitespace is described with the emphasis of the text before it since
+    //! markdown can't express emphasis that only applies to whitespace.
+    QString describe(const QTextDocument& document)
+    {
+        QStringList blocks;
+
+        for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+            QString description;
+            QString tags;
+
+            for (QTextBlock::Iterator iterator = block.begin(); !iterator.atEnd(); iterator++) {
+                const QTextFragment fragment = iterator.fragment();
+                const QTextCharFormat format = fragment.charFormat();
+                QString fragmentTags;
+
+                if (format.fontWeight() >= QFont::Bold) fragmentTags += 'b';
+                if (format.fontItalic()) fragmentTags += 'i';
+                if (format.fontStrikeOut()) fragmentTags += 's';
+
+                for (const QChar character : fragment.text()) {
+                    if (!character.isSpace() && fragmentTags != tags) {
+                        if (!tags.isEmpty()) {
+                            description += "</" + tags + ">";
+                        }
+
+                        if (!fragmentTags.isEmpty()) {
+                            description += "<" + fragmentTags + ">";
+                        }
+
+                        tags = fragmentTags;
+                    }
+
+                    description += character;
+                }
+            }
+
+            if (!tags.isEmpty()) {
+                description += "</" + tags + ">";
+            }
+
+            blocks.append(description);
+        }
+
+        return blocks.join('\n');
+    }
+
+    //! Writes the document, parses the markdown into a new document and
+    //! checks that the text and emphasis survived. Returns the markdown.
+    QString expectRoundTrip(QTextDocument& document)
+    {
+        const QString markdown = write(document);
+        QTextDocument parsed;
+        MarkdownParser(&parsed, blockFormats()).parse(markdown);
+
+        EXPECT_EQ(describe(parsed), describe(document)) << qPrintable(markdown);
+        EXPECT_EQ(write(parsed), markdown);
+
+        return markdown;
+    }
+
+    TEST(MarkdownParser, findsHeadingOffsets) {
+        EXPECT_EQ(headingOffsets("# One\nText\n## Two\n###### Six\n#\n"), QVector<qint64>({ 0, 11, 18, 29 }));
+        EXPECT_EQ(headingOffsets("Text\n#\tTab"), QVector<qint64>({ 5 }));
+    }
+
+    TEST(MarkdownParser, ignoresHashtagsInParagraphs) {
+        // Splitting at the second line would turn one paragraph into two.
+        EXPECT_EQ(headingOffsets("A paragraph that\n#continues with a tag\nin the next line.\n"), QVector<qint64>());
+        EXPECT_EQ(headingOffsets("####### Seven\n"), QVector<qint64>());
+    }
+
+    TEST(MarkdownParser, ignoresHeadingsInFencedCode) {
+        EXPECT_EQ(headingOffsets("```\n# Comment\n```\n# Heading\n"), QVector<qint64>({ 18 }));
+        // A fence is only closed by a fence of the same kind that is at least
+        // as long as the opening one.
+        EXPECT_EQ(headingOffsets("~~~~\n# A\n~~~\n```\n# B\n~~~~\n# C\n"), QVector<qint64>({ 26 }));
+    }
+
+    TEST(MarkdownParser, escapesMarksAtVectorBoundaries) {
+        // Eight characters are searched at once, so the marks are placed at
+        // the start, end and just after each vector.
+        for (const QChar mark : QStringLiteral("*_~\\")) {
+            for (const int index : { 0, 1, 7, 8, 9, 15, 16, 17, 31, 39 }) {
+                QString text(40, 'a');
+                text[index] = mark;
+
+                QTextDocument document;
+                QTextCursor(&document).insertText(text);
+
+                QString expected = text;
+                expected.insert(index, '\\');
+
+                EXPECT_EQ(expectRoundTrip(document), expected + "\n\n") << index;
+            }
+        }
+    }
+
+    TEST(MarkdownParser, escapesConsecutiveMarks) {
+        QTextDocument document;
+        QTextCursor(&document).insertText("plain **not bold** __ ~~ \\\\ a*b_c~d\\e");
+
+        EXPECT_EQ(expectRoundTrip(document), "plain \\*\\*not bold\\*\\* \\_\\_ \\~\\~ \\\\\\\\ a\\*b\\_c\\~d\\\\e\n\n");
+    }
+
+    TEST(MarkdownParser, writesNestedMarks) {
+        QTextDocument document;
+        QTextCursor cursor(&document);
+        insertBlock(cursor, { { "b", "bold " }, { "bi", "both" }, { "b", " bold" } });
+        insertBlock(cursor, { { "i", "a " }, { "is", "struck" }, { "i", " c" } });
+        insertBlock(cursor, { { "b", "*star*" }, { "", " and " }, { "i", "_under_" } });
+
+        EXPECT_EQ(expectRoundTrip(document),
+                  "**bold *both* bold**\n\n"
+                  "*a ~struck~ c*\n\n"
+                  "**\\*star\\*** and *\\_under\\_*\n\n");
+    }
+
+    TEST(MarkdownParser, writesOverlappingMarks) {
+        QTextDocument document;
+        QTextCursor cursor(&document);
+        // Bold ends while italic goes on, so italic has to be closed and
+        // opened again.
+        insertBlock(cursor, { { "b", "very " }, { "bi", "loudly" }, { "i", " and left" } });
+        insertBlock(cursor, { { "s", "gone " }, { "bs", "for" }, { "b", " good" }, { "", "." } });
+
+        EXPECT_EQ(expectRoundTrip(document),
+                  "**very *loudly*** *and left*\n\n"
+                  "~gone **for**~ **good**.\n\n");
+    }
+
+    TEST(MarkdownParser, writesWhitespaceOutsideOfMarks) {
+        QTextDocument document;
+        QTextCursor cursor(&document);
+        insertBlock(cursor, { { "", "a" }, { "b", " bold " }, { "", "word" } });
+        insertBlock(cursor, { { "i", "#tag" } });
+
+        EXPECT_EQ(expectRoundTrip(document), "a **bold** word\n\n*\\#tag*\n\n");
+    }
+
+    TEST(MarkdownParser, writesTheSameInParallelAsSerially) {
+        QTextDocument document;
+        QTextCursor cursor(&document);
+        const QStringList tags = { "", "b", "i", "s", "bi", "is", "bis" };
+
+        // Well above the number of stale blocks from which on they are
+        // serialized in parallel.
+        for (int i = 0; i < 1500; i++) {
+            switch (i % 11) {
+                case 0:
+                    insertBlock(cursor, { { "", QString("Chapter %1").arg(i) } });
+                    cursor.setBlockFormat(blockFormats().headings.at(i % 6));
+                    break;
+                case 5:
+                    insertBlock(cursor, {});
+                    cursor.setBlockFormat(format::sceneBreakFormat);
+                    break;
+                case 7:
+                    insertBlock(cursor, {});
+                    break;
+                default:
+                    insertBlock(cursor, {
+                        { tags.at(i % tags.size()), QString("#%1 *word* ").arg(i) },
+                        { tags.at((i + 1) % tags.size()), "snake_case" },
+                        { tags.at((i + 3) % tags.size()), QString(" and \\ more ").repeated(i % 4) }
+                    });
+            }
+        }
+
+        // Serializes all blocks at once, i.e. in parallel.
+        const QString parallel = write(document);
+
+        // Serializes a few blocks at a time, i.e. serially, and writes the
+        // cached results of all of them.
+        MarkdownParser parser(&document, blockFormats());
+
+        for (int position = 0; position < document.characterCount(); position += 2000) {
+            MarkdownParser::invalidate(&document, position, 1999);
+            parser.serializeBlocks();
+        }
+
+        EXPECT_EQ(write(document).toUtf8(), parallel.toUtf8());
+    }
+}
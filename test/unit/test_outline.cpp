@@ -0,0 +1,77 @@
+#include "gtest/gtest.h"
+#include <QPair>
+#include <QTextCursor>
+#include <QTextDocument>
+#include "text/outline.h"
+#include "customqtprint.h"
+
+namespace {
+    //! Fills the document with a block for each of the heading levels,
+    //! where 0 stands for a paragraph. Each block is six characters long.
+    void setHeadingLevels(QTextDocument& document, const QVector<int>& levels)
+    {
+        QTextCursor cursor(&document);
+
+        for (int i = 0; i < levels.size(); i++) {
+            if (i > 0) {
+                cursor.insertBlock();
+            }
+
+            QTextBlockFormat format;
+            format.setHeadingLevel(levels.at(i));
+            cursor.setBlockFormat(format);
+            cursor.insertText("Block");
+        }
+    }
+
+    QVector<QPair<int, int>> pairs(const QVector<outline::Entry>& entries)
+    {
+        QVector<QPair<int, int>> pairs;
+
+        for (const outline::Entry& entry : entries) {
+            pairs.append({ entry.position, entry.depth });
+        }
+
+        return pairs;
+    }
+
+    // A heading followed by its subheading, then headings of all depths.
+    const QVector<int> levels = { 1, 2, 0, 3, 0, 2, 0, 1, 0, 1, 2 };
+    const QVector<QPair<int, int>> expected = { { 0, 1 }, { 18, 3 }, { 30, 2 }, { 42, 1 }, { 54, 1 } };
+
+    TEST(outline, dividesAtHeadings) {
+        QTextDocument document;
+        setHeadingLevels(document, levels);
+
+        EXPECT_EQ(pairs(outline::entries(&document)), expected);
+    }
+
+    TEST(outline, dividesFromAnyEntry) {
+        QTextDocument document;
+        setHeadingLevels(document, levels);
+
+        for (int i = 0; i < expected.size(); i++) {
+            const outline::Entry first { expected.at(i).first, expected.at(i).second };
+
+            EXPECT_EQ(pairs(outline::entries(&document, first, [](const outline::Entry&) { return false; })), expected.mid(i));
+        }
+    }
+
+    TEST(outline, stopsBeforeEntry) {
+        QTextDocument document;
+        setHeadingLevels(document, levels);
+        int stoppedAt = -1;
+
+        const QVector<outline::Entry> entries = outline::entries(&document, { 18, 3 }, [&stoppedAt](const outline::Entry& entry) {
+            if (entry.position < 42) {
+                return false;
+            }
+
+            stoppedAt = entry.position;
+            return true;
+        });
+
+        EXPECT_EQ(pairs(entries), expected.mid(1, 2));
+        EXPECT_EQ(stoppedAt, 42);
+    }
+}
@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+#include "text/PrefixSums.h"
+
+namespace {
+    TEST(PrefixSums, sumsRanges) {
+        PrefixSums sums;
+        sums.reset({ 3, 0, 4, 1, 5 });
+
+        EXPECT_EQ(sums.size(), 5);
+        EXPECT_EQ(sums.total(), 13);
+        EXPECT_EQ(sums.sumBefore(0), 0);
+        EXPECT_EQ(sums.sumBefore(3), 7);
+        EXPECT_EQ(sums.sum(1, 4), 5);
+
+        sums.add(1, 2);
+        sums.setValue(4, 0);
+
+        EXPECT_EQ(sums.value(1), 2);
+        EXPECT_EQ(sums.sumBefore(3), 9);
+        EXPECT_EQ(sums.total(), 10);
+    }
+
+    TEST(PrefixSums, findsIndexOfOffset) {
+        PrefixSums sums;
+        EXPECT_EQ(sums.indexOf(0), -1);
+
+        // Regarded as lengths, the values start at 0, 3, 3, 7 and 8.
+        sums.reset({ 3, 0, 4, 1, 5 });
+
+        EXPECT_EQ(sums.indexOf(0), 0);
+        EXPECT_EQ(sums.indexOf(2), 0);
+        // Empty values are skipped in favour of the last one at the offset.
+        EXPECT_EQ(sums.indexOf(3), 2);
+        EXPECT_EQ(sums.indexOf(7), 3);
+        EXPECT_EQ(sums.indexOf(12), 4);
+        EXPECT_EQ(sums.indexOf(100), 4);
+    }
+
+    TEST(PrefixSums, insertsAndRemovesValues) {
+        PrefixSums sums;
+        sums.insert(0, { 2, 3 });
+        sums.insert(1, { 5 });
+        sums.insert(3, { 7 });
+
+        // 2, 5, 3, 7
+        EXPECT_EQ(sums.size(), 4);
+        EXPECT_EQ(sums.value(1), 5);
+        EXPECT_EQ(sums.sumBefore(3), 10);
+        EXPECT_EQ(sums.indexOf(7), 2);
+
+        sums.remove(1, 2);
+
+        // 2, 7
+        EXPECT_EQ(sums.size(), 2);
+        EXPECT_EQ(sums.value(1), 7);
+        EXPECT_EQ(sums.total(), 9);
+
+        // Removing beyond the end only removes what's there.
+        sums.remove(1, 10);
+        EXPECT_EQ(sums.size(), 1);
+        EXPECT_EQ(sums.total(), 2);
+    }
+
+    TEST(PrefixSums, matchesLinearSumsAfterInsertionsAndRemovals) {
+        PrefixSums sums;
+        QVector<int> values;
+
+        // Enough values for the chunks to be split and emptied repeatedly.
+        for (int i = 0; i < 300; i++) {
+            const int index = (i * 37) % (values.size() + 1);
+            const QVector<int> inserted(i % 7 == 0 ? 150 : i % 3 + 1, i % 5);
+
+            sums.insert(index, inserted);
+
+            for (int j = 0; j < inserted.size(); j++) {
+                values.insert(index, inserted.at(j));
+            }
+
+            if (i % 4 == 3) {
+                const int removedIndex = (i * 53) % values.size();
+                const int removed = qMin(i % 2 == 0 ? 200 : 2, values.size() - removedIndex);
+
+                sums.remove(removedIndex, removed);
+                values.remove(removedIndex, removed);
+            }
+
+            ASSERT_EQ(sums.size(), values.size());
+        }
+
+        int sum = 0;
+
+        for (int i = 0; i < values.size(); i++) {
+            EXPECT_EQ(sums.value(i), values.at(i)) << i;
+            EXPECT_EQ(sums.sumBefore(i), sum) << i;
+            sum += values.at(i);
+        }
+
+        EXPECT_EQ(sums.total(), sum);
+    }
+}
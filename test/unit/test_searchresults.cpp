@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+#include <QString>
+#include "text/searchresults.h"
+
+namespace {
+    //! Finds all occurrences of the word between from and until, which is
+    //! what the text area does for the blocks of a document.
+    QVector<Range<int>> findAll(const QString& text, const QString& word, const int from = 0, int until = -1)
+    {
+        if (until < 0) {
+            until = text.size();
+        }
+
+        QVector<Range<int>> matches;
+
+        for (int index = text.indexOf(word, from); index >= 0 && index + word.size() <= until; index = text.indexOf(word, index + word.size())) {
+            matches.append(Range<int>(index, index + word.size()));
+        }
+
+        return matches;
+    }
+
+    //! Extends the range to the lines that contain it, like
+    //! FormattableTextArea::updateFindRanges() extends it to whole blocks.
+    Range<int> lines(const QString& text, const int from, const int until)
+    {
+        const int end = text.indexOf('\n', until);
+
+        return Range<int>(from > 0 ? text.lastIndexOf('\n', from - 1) + 1 : 0, end < 0 ? text.size() : end + 1);
+    }
+
+    //! Replaces removed characters at the position of the text by inserted,
+    //! then splices the matches of the word in the edited lines into the
+    //! previous matches and checks that the result is the same as searching
+    //! all of the edited text.
+    void expectSplice(const QString& text, const int position, const int removed, const QString& inserted)
+    {
+        const QString word = QStringLiteral("cat");
+        const QString edited = QString(text).replace(position, removed, inserted);
+        // Like FormattableTextArea::scheduleChange(), the changed range
+        // contains at least one character.
+        const Range<int> changed = lines(edited, position, position + qMax(inserted.size(), 1));
+        const int offset = inserted.size() - removed;
+
+        const QVector<Range<int>> spliced = searchresults::splice(findAll(text, word), changed.from(), changed.until(), offset,
+                                                                  findAll(edited, word, changed.from(), changed.until()));
+
+        EXPECT_EQ(spliced, findAll(edited, word)) << qPrintable(edited);
+    }
+
+    const QString sample = QStringLiteral("cat and cat\nno match\nthe cat sat\ncat\nlast cat");
+
+    TEST(searchresults, splicesEditsBeforeMatches) {
+        expectSplice(sample, 0, 0, "a ");
+        expectSplice(sample, 12, 0, "more ");
+        expectSplice(sample, 12, 3, "");
+    }
+
+    TEST(searchresults, splicesEditsInsideMatches) {
+        // Breaks a match.
+        expectSplice(sample, 1, 0, "-");
+        // Creates a match.
+        expectSplice(sample, 16, 3, "cat");
+        expectSplice("ca t\ncat", 2, 1, "");
+        // Replaces a match with a longer one.
+        expectSplice(sample, 8, 3, "catcat");
+    }
+
+    TEST(searchresults, splicesEditsAcrossMatches) {
+        expectSplice(sample, 5, 10, "");
+        expectSplice(sample, 2, 30, "t c");
+        expectSplice(sample, 0, sample.size(), "cat");
+    }
+
+    TEST(searchresults, splicesEditsThatAddOrRemoveBlocks) {
+        expectSplice(sample, 11, 0, "\ncat\ncat and cat");
+        expectSplice(sample, 4, 0, "\n");
+        // Joins "sat" and "cat" into a single line.
+        expectSplice(sample, 32, 1, "");
+        expectSplice(sample, 10, 22, "\n");
+        expectSplice(sample, sample.size(), 0, "\ncat");
+    }
+
+    TEST(searchresults, splicesIntoEmptyResults) {
+        EXPECT_EQ(searchresults::splice({}, 0, 5, 2, { Range<int>(1, 4) }), QVector<Range<int>>({ Range<int>(1, 4) }));
+        EXPECT_EQ(searchresults::splice({ Range<int>(10, 13) }, 0, 5, -2, {}), QVector<Range<int>>({ Range<int>(8, 11) }));
+    }
+
+    TEST(searchresults, mapsMatchesBeforeTheEditedRange) {
+        const QVector<Range<int>> matches = { Range<int>(0, 3), Range<int>(5, 8) };
+
+        EXPECT_EQ(searchresults::map(matches, Range<int>(8, 20), 4), matches);
+        EXPECT_EQ(searchresults::map(matches, Range<int>(8, 12), -4), matches);
+    }
+
+    TEST(searchresults, dropsMatchesInsideTheEditedRange) {
+        // The edited range is [10, 20) now and was [10, 16) or [10, 24).
+        const QVector<Range<int>> matches = { Range<int>(8, 11), Range<int>(12, 15), Range<int>(14, 17) };
+
+        EXPECT_EQ(searchresults::map(matches, Range<int>(10, 20), 4), QVector<Range<int>>());
+        EXPECT_EQ(searchresults::map(matches, Range<int>(10, 20), -4), QVector<Range<int>>());
+    }
+
+    TEST(searchresults, shiftsMatchesAfterTheEditedRange) {
+        // The edited range ended at 16 before the text grew by 4.
+        EXPECT_EQ(searchresults::map({ Range<int>(16, 19), Range<int>(30, 33) }, Range<int>(10, 20), 4),
+                  QVector<Range<int>>({ Range<int>(20, 23), Range<int>(34, 37) }));
+        EXPECT_EQ(searchresults::map({ Range<int>(15, 18) }, Range<int>(10, 20), 4), QVector<Range<int>>());
+
+        // The edited range ended at 24 before the text shrank by 4.
+        EXPECT_EQ(searchresults::map({ Range<int>(24, 27), Range<int>(30, 33) }, Range<int>(10, 20), -4),
+                  QVector<Range<int>>({ Range<int>(20, 23), Range<int>(26, 29) }));
+        EXPECT_EQ(searchresults::map({ Range<int>(21, 24) }, Range<int>(10, 20), -4), QVector<Range<int>>());
+    }
+
+    TEST(searchresults, mapsBatchesAcrossTheEditedRange) {
+        const QVector<Range<int>> matches = { Range<int>(2, 5), Range<int>(9, 12), Range<int>(17, 20), Range<int>(25, 28) };
+
+        EXPECT_EQ(searchresults::map(matches, Range<int>(10, 20), 3),
+                  QVector<Range<int>>({ Range<int>(2, 5), Range<int>(20, 23), Range<int>(28, 31) }));
+        EXPECT_EQ(searchresults::map(matches, Range<int>(10, 20), -3),
+                  QVector<Range<int>>({ Range<int>(2, 5), Range<int>(22, 25) }));
+    }
+
+    TEST(searchresults, keepsMatchesWithoutAnEditedRange) {
+        const QVector<Range<int>> matches = { Range<int>(2, 5), Range<int>(9, 12) };
+
+        EXPECT_EQ(searchresults::map(matches, Range<int>(), 7), matches);
+    }
+}
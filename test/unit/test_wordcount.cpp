@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include "text/TextIterator.h"
+#include "text/UserData.h"
+#include "text/wordcount.h"
+#include "customqtprint.h"
+
+namespace {
+    //! Counts the words in the block the way countWords() used to, which
+    //! serves as the reference for wordcount::count().
+    int countWithTextIterator(const QTextBlock& block)
+    {
+        QTextCursor cursor(block);
+        cursor.select(QTextCursor::SelectionType::BlockUnderCursor);
+        TextIterator iterator(cursor, TextIterator::IterationType::ByWord);
+        int words = 0;
+
+        while (!iterator.atEnd()) {
+            if (!iterator.current().isEmpty()) {
+                words++;
+            }
+
+            iterator++;
+        }
+
+        return words;
+    }
+
+    TEST(wordcount, countsWordsSeparatedBySpaces) {
+        EXPECT_EQ(wordcount::count("A word."), 2);
+        EXPECT_EQ(wordcount::count("  leading and trailing  "), 3);
+        EXPECT_EQ(wordcount::count(""), 0);
+    }
+
+    TEST(wordcount, ignoresFreeStandingSymbols) {
+        EXPECT_EQ(wordcount::count("--- *** ..."), 0);
+        EXPECT_EQ(wordcount::count("“I hate you,” Anakin said."), 5);
+    }
+
+    TEST(wordcount, separatesOnDashes) {
+        EXPECT_EQ(wordcount::count("dash-separated"), 1);
+        EXPECT_EQ(wordcount::count("dash--separated"), 2);
+        EXPECT_EQ(wordcount::count("em—dash"), 2);
+        EXPECT_EQ(wordcount::count("en–dash"), 2);
+    }
+
+    TEST(wordcount, separatesOnRepeatedApostrophes) {
+        EXPECT_EQ(wordcount::count("There's"), 1);
+        EXPECT_EQ(wordcount::count("There’s"), 1);
+        EXPECT_EQ(wordcount::count("There''s"), 2);
+    }
+
+    TEST(wordcount, doesNotSeparateOnPunctuation) {
+        // Only the characters in symbols::word_separators separate words.
+        EXPECT_EQ(wordcount::count("comma,separated"), 1);
+    }
+
+    TEST(wordcount, skipsComments) {
+        const QString text = "before [a comment] after";
+        EXPECT_EQ(wordcount::count(text, { Range<int>(7, 18) }), 2);
+        EXPECT_EQ(wordcount::count(text, { Range<int>(0, text.size()) }), 0);
+        // Skipped characters don't separate words either.
+        EXPECT_EQ(wordcount::count("split[ ]word", { Range<int>(5, 8) }), 1);
+    }
+
+    TEST(wordcount, acceptsUnsortedAndOverlappingComments) {
+        const QString text = "one two three four";
+        EXPECT_EQ(wordcount::count(text, { Range<int>(8, 13), Range<int>(0, 3) }), 2);
+        EXPECT_EQ(wordcount::count(text, { Range<int>(0, 6), Range<int>(2, 9) }), 2);
+    }
+
+    TEST(wordcount, countsIdeographsAsWords) {
+        const wordcount::Rules rules = wordcount::Rules::Ideographic;
+        EXPECT_EQ(wordcount::count("日本語のテキスト", {}, rules), 8);
+        EXPECT_EQ(wordcount::count("Hello 世界", {}, rules), 3);
+        EXPECT_EQ(wordcount::count("東京　大阪", {}, rules), 4);
+        EXPECT_EQ(wordcount::count("em—dash and dash-separated", {}, rules), 4);
+        // Other scripts are counted as usual.
+        EXPECT_EQ(wordcount::count("Ünïcödé wörds", {}, rules), 2);
+    }
+
+    TEST(wordcount, splitsCompounds) {
+        const wordcount::Rules rules = wordcount::Rules::SplitCompounds;
+        EXPECT_EQ(wordcount::count("dash-separated", {}, rules), 2);
+        EXPECT_EQ(wordcount::count("dash--separated", {}, rules), 2);
+        EXPECT_EQ(wordcount::count("- dash -", {}, rules), 1);
+        EXPECT_EQ(wordcount::count("There's", {}, rules), 1);
+    }
+
+    TEST(wordcount, splitsApostrophes) {
+        const wordcount::Rules rules = wordcount::Rules::SplitApostrophes;
+        EXPECT_EQ(wordcount::count("l'homme", {}, rules), 2);
+        EXPECT_EQ(wordcount::count("l’homme d’affaires", {}, rules), 4);
+        EXPECT_EQ(wordcount::count("'quoted'", {}, rules), 1);
+        EXPECT_EQ(wordcount::count("dash-separated", {}, rules), 1);
+    }
+
+    TEST(wordcount, matchesTextIterator) {
+        QTextDocument document;
+        document.setPlainText(
+            "A word.\n"
+            "With multiple periods...\n"
+            "Combined with a dash-separated word. There's also an apostrophe.\n"
+            "“I hate you,” Anakin said.\n"
+            "\n"
+            "Double--dash and double''apostrophe and em—dash and en – dash.\n"
+            "A [commented out] sentence with [two comments] in it.\n"
+            "Numbers like 42 and 3.14 count, but # and * don't.\n"
+            "Ünïcödé wörds, 日本語, and ’quoted’ words."
+        );
+
+        QTextBlock commented = document.findBlockByNumber(6);
+        UserData::fromBlock(commented).addCommentRange(2, 17);
+        UserData::fromBlock(commented).addCommentRange(32, 46);
+
+        for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+            EXPECT_EQ(wordcount::count(block), countWithTextIterator(block)) << block.text();
+        }
+    }
+
+    TEST(wordcount, matchesTextIteratorOnPartialBlocks) {
+        QTextDocument document;
+        document.setPlainText("A [commented out] sentence with double--dashes in it.");
+
+        QTextBlock block = document.begin();
+        UserData::fromBlock(block).addCommentRange(2, 17);
+
+        for (int from = 0; from < block.length() - 1; from++) {
+            for (int until = from; until < block.length(); until++) {
+                QTextCursor cursor(block);
+                cursor.setPosition(from);
+                cursor.setPosition(until, QTextCursor::KeepAnchor);
+                TextIterator iterator(cursor, TextIterator::IterationType::ByWord);
+                int words = 0;
+
+                while (!iterator.atEnd()) {
+                    if (!iterator.current().isEmpty()) {
+                        words++;
+                    }
+
+                    iterator++;
+                }
+
+                EXPECT_EQ(wordcount::count(block, from, until), words) << from << until;
+            }
+        }
+    }
+}
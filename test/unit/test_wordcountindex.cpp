@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+#include <QTextBlock>
+#include <QTextDocument>
+#include "text/UserData.h"
+#include "text/WordCountIndex.h"
+#include "customqtprint.h"
+
+namespace {
+    TEST(WordCountIndex, isEmptyByDefault) {
+        WordCountIndex index;
+        EXPECT_EQ(index.size(), 0);
+        EXPECT_EQ(index.total(), 0);
+        EXPECT_EQ(index.wordCount(0, 10), 0);
+    }
+
+    TEST(WordCountIndex, readsCountsFromDocument) {
+        QTextDocument document;
+        document.setPlainText("one\ntwo\nthree\nfour\nfive");
+
+        int words = 1;
+        for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+            UserData::fromBlock(block).setWordCount(words++);
+        }
+
+        WordCountIndex index;
+        index.reset(&document);
+
+        EXPECT_EQ(index.size(), 5);
+        EXPECT_EQ(index.total(), 15);
+        EXPECT_EQ(index.wordCount(2), 3);
+        EXPECT_EQ(index.wordsBefore(0), 0);
+        EXPECT_EQ(index.wordsBefore(3), 6);
+        EXPECT_EQ(index.wordCount(1, 4), 9);
+        EXPECT_EQ(index.wordCount(4, 1), 0);
+    }
+
+    TEST(WordCountIndex, matchesLinearSumsAfterUpdates) {
+        QTextDocument document;
+        document.setPlainText(QString("block\n").repeated(37));
+
+        WordCountIndex index;
+        index.reset(&document);
+
+        QVector<int> counts(index.size(), 0);
+
+        for (int i = 0; i < 200; i++) {
+            const int blockNumber = (i * 7) % counts.size();
+            counts[blockNumber] = (i * 13) % 11;
+            index.setWordCount(blockNumber, counts.at(blockNumber));
+        }
+
+        for (int from = 0; from <= counts.size(); from++) {
+            for (int until = from; until <= counts.size(); until++) {
+                int expected = 0;
+
+                for (int i = from; i < until; i++) {
+                    expected += counts.at(i);
+                }
+
+                EXPECT_EQ(index.wordCount(from, until), expected) << from << until;
+            }
+        }
+    }
+
+    TEST(WordCountIndex, shiftsCountsWhenBlocksAreInsertedOrRemoved) {
+        QTextDocument document;
+        document.setPlainText("one\ntwo\nthree");
+
+        int words = 1;
+        for (QTextBlock block = document.begin(); block.isValid(); block = block.next()) {
+            UserData::fromBlock(block).setWordCount(words++);
+        }
+
+        WordCountIndex index;
+        index.reset(&document);
+
+        index.insertBlocks(1, 2);
+
+        EXPECT_EQ(index.size(), 5);
+        EXPECT_EQ(index.wordCount(1), 0);
+        EXPECT_EQ(index.wordCount(3), 2);
+        EXPECT_EQ(index.wordsBefore(4), 3);
+
+        index.removeBlocks(0, 3);
+
+        EXPECT_EQ(index.size(), 2);
+        EXPECT_EQ(index.wordCount(0), 2);
+        EXPECT_EQ(index.total(), 5);
+    }
+}